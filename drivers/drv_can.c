@@ -16,27 +16,463 @@
 
 #ifdef RT_USING_CAN
 
+/* identifier of a frame or filter as one word: ide << 30 | rtr << 29 | id */
+#define SWM181_CAN_KEY(ide, rtr, id)    (((rt_uint32_t)(ide) << 30) | ((rt_uint32_t)(rtr) << 29) | (id))
+
+#ifdef BSP_CAN_USING_DMA_RX
+/* The channel copies CAN->FRAME, INFO and DATA[12], once per received frame. A slot is free
+ * while its last word holds SWM181_CAN_DMA_EMPTY, which no register byte can read back as. */
+#define SWM181_CAN_DMA_WORDS    13
+#define SWM181_CAN_DMA_EMPTY    0xFFFFFFFFUL
+#define SWM181_CAN_DMA_FRAMES   (BSP_CAN_DMA_BATCH * BSP_CAN_DMA_CHUNKS)
+
+struct swm181_can_raw
+{
+    volatile rt_uint32_t info;
+    volatile rt_uint32_t data[SWM181_CAN_DMA_WORDS - 1];
+};
+
+static struct swm181_can_raw can_dma_ring[SWM181_CAN_DMA_FRAMES];
+#endif
+
+struct swm181_can_filter
+{
+    rt_uint32_t key;            /* SWM181_CAN_KEY(), bits outside care cleared */
+    rt_uint32_t care;           /* key bits that must match */
+};
+
+/* box of frames from swm181_can_send(), the lower bits carry the caller's tag */
+#define SWM181_CAN_TX_DIRECT    0x80000000UL
+
+/* a frame waiting for the single hardware TX buffer */
+struct swm181_can_tx
+{
+    rt_uint32_t key;            /* arbitration order, lower wins */
+    rt_uint32_t box;            /* send box of the device core, reported in TX_DONE / TX_FAIL */
+    struct rt_can_msg msg;
+};
+
 struct swm181_can
 {
     struct rt_can_device parent;
     CAN_TypeDef *CANx;
     const char *name;
+
+    /* The hardware acceptance filter only narrows things down; every frame it lets through is
+     * checked against filter[]. filter[0..filter_exact) are list entries sorted by key for a
+     * binary search, the mask entries follow. filter_count == 0 accepts everything. */
+    struct swm181_can_filter filter[BSP_CAN_FILTER_MAX];
+    rt_uint8_t filter_count;
+    rt_uint8_t filter_exact;
+    rt_uint8_t hw_filter_mode;  /* CAN_FILTER_32b / CAN_FILTER_16b */
+    rt_uint32_t hw_check;       /* 16b mode: filter 2 in the upper half */
+    rt_uint32_t hw_mask;        /* 1: don't care */
+
+    /* Frames are handed to the TX buffer lowest arbitration key first: tx_heap[] is a binary
+     * min-heap, tx_cur is on the wire while tx_busy. */
+    struct swm181_can_tx tx_heap[BSP_CAN_TX_QUEUE_LEN];
+    rt_uint8_t tx_count;
+    rt_bool_t tx_busy;
+    rt_bool_t tx_aborting;      /* tx_cur is being pulled back for a more urgent frame */
+    rt_bool_t tx_hold;          /* in reset mode for reconfiguration, frames only queue */
+    struct swm181_can_tx tx_cur;
+
+    /* On bus-off the controller is held in reset for backoff_ms before recovery may start, the
+     * delay doubles up to backoff_max each time recovery ends in bus-off again and drops back
+     * once a frame got through. */
+    rt_bool_t bus_off;
+    rt_bool_t recovered;        /* back from bus-off, no frame sent yet */
+    rt_uint32_t errcode;        /* RT_CAN_STATUS_MODE bits */
+    rt_uint32_t lasterrtype;    /* RT_CAN_BUS_xxx */
+    rt_uint32_t backoff_ms;
+    rt_uint32_t backoff_min;
+    rt_uint32_t backoff_max;
+    struct rt_timer bus_on;
+    struct swm181_can_stats stats;
+
+    struct swm181_can_hook hook;
+
+#ifdef BSP_CAN_USING_DMA_RX
+    /* The ring is cut into chunks of BSP_CAN_DMA_BATCH frames, the channel fills one chunk at
+     * a time. When the next chunk still holds undecoded frames the channel is stopped and
+     * reception falls back to the RXDA interrupt until the ring has drained. */
+    rt_uint16_t dma_rd;         /* next frame to decode */
+    rt_uint16_t dma_chunk;      /* chunk the channel is filling */
+    rt_bool_t dma_fallback;
+    struct rt_timer dma_flush;  /* hands over frames of a chunk that is not full yet */
+#endif
 };
 
 static struct swm181_can can_obj;
 
+static int swm181_can_popcount(rt_uint32_t v)
+{
+    int n = 0;
+
+    for (; v; v &= v - 1)
+        n++;
+
+    return n;
+}
+
+/* Acceptance code layout of a single (32-bit) filter: standard frames compare ID10..0 and RTR
+ * in bits 31..20, extended frames ID28..0 and RTR in bits 31..2. */
+static void swm181_can_filter_enc32(const struct rt_can_filter_item *item, rt_uint32_t *val, rt_uint32_t *care)
+{
+    rt_uint32_t mask = item->mode ? 0x1FFFFFFF : item->mask;
+
+    if (item->ide == RT_CAN_STDID)
+    {
+        *care = ((mask & 0x7FF) << 21) | (1UL << 20);
+        *val = (((rt_uint32_t)item->id << 21) | ((rt_uint32_t)item->rtr << 20)) & *care;
+    }
+    else
+    {
+        *care = ((mask & 0x1FFFFFFF) << 3) | (1UL << 2);
+        *val = (((rt_uint32_t)item->id << 3) | ((rt_uint32_t)item->rtr << 2)) & *care;
+    }
+}
+
+/* Each of the dual filters sees the first 16 identifier bits: ID10..0 and RTR of standard
+ * frames, only ID28..13 of extended ones. */
+static void swm181_can_filter_enc16(const struct rt_can_filter_item *item, rt_uint32_t *val, rt_uint32_t *care)
+{
+    rt_uint32_t mask = item->mode ? 0x1FFFFFFF : item->mask;
+
+    if (item->ide == RT_CAN_STDID)
+    {
+        *care = ((mask & 0x7FF) << 5) | (1UL << 4);
+        *val = (((rt_uint32_t)item->id << 5) | ((rt_uint32_t)item->rtr << 4)) & *care;
+    }
+    else
+    {
+        *care = (mask >> 13) & 0xFFFF;
+        *val = ((rt_uint32_t)item->id >> 13) & *care;
+    }
+}
+
+/* smallest filter accepting everything both (val, care) pairs accept */
+rt_inline void swm181_can_filter_merge(rt_uint32_t *val, rt_uint32_t *care, rt_uint32_t val2, rt_uint32_t care2)
+{
+    *care &= care2 & ~(*val ^ val2);
+    *val &= *care;
+}
+
+/* Pick single 32-bit or dual 16-bit hardware filtering, whichever lets fewer unwanted frames
+ * through; the pass rate of a filter is estimated as 2^-(bits it compares). */
+static void swm181_can_filter_plan(struct swm181_can *swm_can, const struct rt_can_filter_item *items, rt_uint32_t count)
+{
+    rt_uint32_t v32, c32, v, c;
+    rt_uint32_t va, ca, vb, cb;
+    rt_uint32_t val16[BSP_CAN_FILTER_MAX], care16[BSP_CAN_FILTER_MAX];
+    rt_uint32_t i, j, seed_a = 0, seed_b = 0;
+    int best = -1, loss_a, loss_b;
+    rt_uint64_t pass32, pass16;
+
+    swm181_can_filter_enc32(&items[0], &v32, &c32);
+    for (i = 1; i < count; i++)
+    {
+        swm181_can_filter_enc32(&items[i], &v, &c);
+        swm181_can_filter_merge(&v32, &c32, v, c);
+    }
+
+    for (i = 0; i < count; i++)
+        swm181_can_filter_enc16(&items[i], &val16[i], &care16[i]);
+
+    /* seed the two groups with the pair that has the fewest compared bits in common */
+    for (i = 0; i < count; i++)
+    {
+        for (j = i + 1; j < count; j++)
+        {
+            va = val16[i]; ca = care16[i];
+            swm181_can_filter_merge(&va, &ca, val16[j], care16[j]);
+            if (best < 0 || swm181_can_popcount(ca) < best)
+            {
+                best = swm181_can_popcount(ca);
+                seed_a = i;
+                seed_b = j;
+            }
+        }
+    }
+
+    va = val16[seed_a]; ca = care16[seed_a];
+    vb = val16[seed_b]; cb = care16[seed_b];
+    for (i = 0; i < count; i++)
+    {
+        if (i == seed_a || i == seed_b)
+            continue;
+
+        v = va; c = ca;
+        swm181_can_filter_merge(&v, &c, val16[i], care16[i]);
+        loss_a = swm181_can_popcount(ca) - swm181_can_popcount(c);
+        v = vb; c = cb;
+        swm181_can_filter_merge(&v, &c, val16[i], care16[i]);
+        loss_b = swm181_can_popcount(cb) - swm181_can_popcount(c);
+
+        if (loss_a <= loss_b)
+            swm181_can_filter_merge(&va, &ca, val16[i], care16[i]);
+        else
+            swm181_can_filter_merge(&vb, &cb, val16[i], care16[i]);
+    }
+
+    pass32 = 1ULL << (32 - swm181_can_popcount(c32));
+    pass16 = (1ULL << (32 - swm181_can_popcount(ca))) + (1ULL << (32 - swm181_can_popcount(cb)));
+
+    if (pass16 < pass32)
+    {
+        swm_can->hw_filter_mode = CAN_FILTER_16b;
+        swm_can->hw_check = (vb << 16) | va;
+        swm_can->hw_mask = ~((cb << 16) | ca);
+    }
+    else
+    {
+        swm_can->hw_filter_mode = CAN_FILTER_32b;
+        swm_can->hw_check = v32;
+        swm_can->hw_mask = ~c32;
+    }
+}
+
+/* only while the controller is in reset mode */
+static void swm181_can_filter_apply(struct swm181_can *swm_can)
+{
+    if (swm_can->filter_count == 0)
+        CAN_SetFilter32b(swm_can->CANx, 0x00000000, 0xFFFFFFFF);
+    else if (swm_can->hw_filter_mode == CAN_FILTER_16b)
+        CAN_SetFilter16b(swm_can->CANx, swm_can->hw_check & 0xFFFF, swm_can->hw_mask & 0xFFFF,
+                         swm_can->hw_check >> 16, swm_can->hw_mask >> 16);
+    else
+        CAN_SetFilter32b(swm_can->CANx, swm_can->hw_check, swm_can->hw_mask);
+}
+
+/* Filter items: mode 0 compares the identifier bits set in mask, mode 1 the whole identifier;
+ * ide and rtr always have to match. */
+static rt_err_t swm181_can_filter_set(struct swm181_can *swm_can, const struct rt_can_filter_config *cfg)
+{
+    rt_uint32_t i, idmask, key, care;
+    struct swm181_can_filter f;
+    int j;
+
+    if (cfg->actived == 0 || cfg->count == 0)
+    {
+        swm_can->filter_count = 0;
+        return RT_EOK;
+    }
+    if (cfg->items == RT_NULL)
+        return -RT_EINVAL;
+    if (cfg->count > BSP_CAN_FILTER_MAX)
+        return -RT_EFULL;
+
+    swm_can->filter_count = 0;
+    swm_can->filter_exact = 0;
+    for (i = 0; i < cfg->count; i++)
+    {
+        const struct rt_can_filter_item *item = &cfg->items[i];
+
+        idmask = (item->ide == RT_CAN_STDID) ? 0x7FF : 0x1FFFFFFF;
+        care = SWM181_CAN_KEY(1, 1, item->mode ? idmask : (item->mask & idmask));
+        key = SWM181_CAN_KEY(item->ide, item->rtr, item->id & idmask) & care;
+
+        f.key = key;
+        f.care = care;
+        if (care == SWM181_CAN_KEY(1, 1, idmask))
+        {
+            /* exact: insert into the sorted part, moving the first mask entry out of the way */
+            swm_can->filter[swm_can->filter_count] = swm_can->filter[swm_can->filter_exact];
+            for (j = swm_can->filter_exact; j > 0 && swm_can->filter[j - 1].key > key; j--)
+                swm_can->filter[j] = swm_can->filter[j - 1];
+            swm_can->filter[j] = f;
+            swm_can->filter_exact++;
+        }
+        else
+        {
+            swm_can->filter[swm_can->filter_count] = f;
+        }
+        swm_can->filter_count++;
+    }
+
+    swm181_can_filter_plan(swm_can, cfg->items, cfg->count);
+
+    return RT_EOK;
+}
+
+static rt_bool_t swm181_can_filter_match(struct swm181_can *swm_can, rt_uint32_t key)
+{
+    int lo = 0, hi = swm_can->filter_exact - 1, mid;
+    int i;
+
+    if (swm_can->filter_count == 0)
+        return RT_TRUE;
+
+    while (lo <= hi)
+    {
+        mid = (lo + hi) / 2;
+        if (swm_can->filter[mid].key == key)
+            return RT_TRUE;
+        if (swm_can->filter[mid].key < key)
+            lo = mid + 1;
+        else
+            hi = mid - 1;
+    }
+
+    for (i = swm_can->filter_exact; i < swm_can->filter_count; i++)
+    {
+        if ((key & swm_can->filter[i].care) == swm_can->filter[i].key)
+            return RT_TRUE;
+    }
+
+    return RT_FALSE;
+}
+
+#ifdef BSP_CAN_USING_DMA_RX
+/* CAN_Receive() on a raw copy of CAN->FRAME */
+static void swm181_can_decode(const volatile rt_uint32_t *info, const volatile rt_uint32_t *data, CAN_RXMessage *rx_msg)
+{
+    rt_uint32_t i;
+
+    rx_msg->format = (*info & CAN_INFO_FF_Msk) >> CAN_INFO_FF_Pos;
+    rx_msg->remote = (*info & CAN_INFO_RTR_Msk) >> CAN_INFO_RTR_Pos;
+    rx_msg->size = (*info & CAN_INFO_DLC_Msk) >> CAN_INFO_DLC_Pos;
+    if (rx_msg->size > 8)
+        rx_msg->size = 8;
+
+    if (rx_msg->format == CAN_FRAME_STD)
+    {
+        rx_msg->id = ((data[0] & 0xFF) << 3) | ((data[1] & 0xFF) >> 5);
+        data += 2;
+    }
+    else
+    {
+        rx_msg->id = ((data[0] & 0xFF) << 21) | ((data[1] & 0xFF) << 13) | ((data[2] & 0xFF) << 5) | ((data[3] & 0xFF) >> 3);
+        data += 4;
+    }
+
+    for (i = 0; i < rx_msg->size; i++)
+        rx_msg->data[i] = data[i];
+}
+
+rt_inline rt_bool_t swm181_can_dma_ready(struct swm181_can *swm_can)
+{
+    return can_dma_ring[swm_can->dma_rd].data[SWM181_CAN_DMA_WORDS - 2] != SWM181_CAN_DMA_EMPTY;
+}
+
+static void swm181_can_dma_arm(struct swm181_can *swm_can)
+{
+    DMA_CH_Config(DMA_CHR_CAN, (uint32_t)&can_dma_ring[swm_can->dma_chunk * BSP_CAN_DMA_BATCH],
+                  BSP_CAN_DMA_BATCH * SWM181_CAN_DMA_WORDS, 1);
+    DMA_CH_Open(DMA_CHR_CAN);
+}
+
+/* (re)start DMA reception on an empty ring */
+static void swm181_can_dma_start(struct swm181_can *swm_can)
+{
+    int i;
+
+    for (i = 0; i < SWM181_CAN_DMA_FRAMES; i++)
+        can_dma_ring[i].data[SWM181_CAN_DMA_WORDS - 2] = SWM181_CAN_DMA_EMPTY;
+    swm_can->dma_rd = 0;
+    swm_can->dma_chunk = 0;
+    swm_can->dma_fallback = RT_FALSE;
+
+    CAN_INTRXNotEmptyDis(swm_can->CANx);
+    swm181_can_dma_arm(swm_can);
+}
+
+static void swm181_can_dma_stop(struct swm181_can *swm_can)
+{
+    DMA_CH_Close(DMA_CHR_CAN);
+    DMA_CH_INTClr(DMA_CHR_CAN);
+    swm_can->CANx->CR &= ~CAN_CR_DMAEN_Msk;
+}
+
+/* pass every decodable frame to the device, one RX_IND each; any context */
+static void swm181_can_dma_deliver(struct swm181_can *swm_can)
+{
+    rt_base_t level;
+
+    level = rt_hw_interrupt_disable();
+    while (swm181_can_dma_ready(swm_can))
+        rt_hw_can_isr(&swm_can->parent, RT_CAN_EVENT_RX_IND | (0 << 8));
+
+    if (swm_can->dma_fallback && !CAN_RXDataAvailable(swm_can->CANx))
+        swm181_can_dma_start(swm_can);
+    rt_hw_interrupt_enable(level);
+}
+
+static void swm181_can_dma_flush(void *parameter)
+{
+    swm181_can_dma_deliver((struct swm181_can *)parameter);
+}
+
+static void swm181_can_dma_isr(struct swm181_can *swm_can)
+{
+    rt_uint16_t next;
+    int i;
+
+    DMA_CH_INTClr(DMA_CHR_CAN);
+
+    next = (swm_can->dma_chunk + 1) % BSP_CAN_DMA_CHUNKS;
+    for (i = 0; i < BSP_CAN_DMA_BATCH; i++)
+    {
+        if (can_dma_ring[next * BSP_CAN_DMA_BATCH + i].data[SWM181_CAN_DMA_WORDS - 2] != SWM181_CAN_DMA_EMPTY)
+            break;
+    }
+
+    if (i == BSP_CAN_DMA_BATCH)
+    {
+        swm_can->dma_chunk = next;
+        swm181_can_dma_arm(swm_can);
+    }
+    else
+    {
+        /* the controller FIFO buffers the frames until the interrupt path takes over */
+        swm_can->stats.dma_overruns++;
+        swm181_can_dma_stop(swm_can);
+        swm_can->dma_fallback = RT_TRUE;
+        CAN_INTRXNotEmptyEn(swm_can->CANx);
+    }
+
+    swm181_can_dma_deliver(swm_can);
+}
+
+void IRQ13_Handler(void)
+{
+    rt_interrupt_enter();
+    if (DMA_CH_INTStat(DMA_CHR_CAN))
+        swm181_can_dma_isr(&can_obj);
+    rt_interrupt_leave();
+}
+#endif /* BSP_CAN_USING_DMA_RX */
+
+/* only while the controller is in reset mode */
+static void swm181_can_set_timing(CAN_TypeDef *CANx, const struct swm181_can_timing *t)
+{
+    CANx->BT1 = (0 << CAN_BT1_SAM_Pos) |
+                (t->bs1 << CAN_BT1_TSEG1_Pos) |
+                (t->bs2 << CAN_BT1_TSEG2_Pos);
+    CANx->BT0 = (t->sjw << CAN_BT0_SJW_Pos) |
+                (t->brp << CAN_BT0_BRP_Pos);
+}
+
+static void swm181_can_reset_enter(struct swm181_can *swm_can);
+static void swm181_can_reset_leave(struct swm181_can *swm_can);
+static void swm181_can_err_update(struct swm181_can *swm_can);
+
 static rt_err_t swm181_can_configure(struct rt_can_device *can, struct can_configure *cfg)
 {
     struct swm181_can *swm_can = (struct swm181_can *)can;
     CAN_InitStructure init_struct;
+    struct swm181_can_timing timing;
+
+    if (swm181_can_calc_timing(SystemCoreClock / 2, cfg->baud_rate, BSP_CAN_SAMPLE_POINT, &timing) != RT_EOK)
+        return -RT_ERROR;
 
     init_struct.Baudrate = cfg->baud_rate;
     init_struct.Mode = (cfg->mode == RT_CAN_MODE_NORMAL) ? CAN_MODE_NORMAL : 
                        (cfg->mode == RT_CAN_MODE_LISTEN) ? CAN_MODE_LISTEN : CAN_MODE_SELFTEST;
     
-    init_struct.CAN_SJW = CAN_SJW_1tq;
-    init_struct.CAN_BS1 = CAN_BS1_8tq;
-    init_struct.CAN_BS2 = CAN_BS2_3tq;
+    init_struct.CAN_SJW = timing.sjw;
+    init_struct.CAN_BS1 = timing.bs1;
+    init_struct.CAN_BS2 = timing.bs2;
     
     init_struct.FilterMode = CAN_FILTER_32b;
     init_struct.FilterCheck32b = 0x00000000;
@@ -47,12 +483,36 @@ static rt_err_t swm181_can_configure(struct rt_can_device *can, struct can_confi
     init_struct.ArbitrLostIEn = 1;
     init_struct.ErrPassiveIEn = 1;
 
+    swm181_can_reset_enter(swm_can);
     CAN_Init(swm_can->CANx, &init_struct);
+    /* CAN_Init() rounds the prescaler down, use the solved one */
+    swm181_can_set_timing(swm_can->CANx, &timing);
+    swm181_can_filter_apply(swm_can);
+    CAN_INTTXBufEmptyEn(swm_can->CANx);
+    CAN_INTErrWarningEn(swm_can->CANx);
+    CAN_INTBusErrorEn(swm_can->CANx);
+
+    rt_timer_stop(&swm_can->bus_on);
+    swm_can->bus_off = RT_FALSE;
+    swm_can->recovered = RT_FALSE;
+    swm_can->backoff_ms = swm_can->backoff_min;
+    rt_memset(&swm_can->stats, 0, sizeof(swm_can->stats));
+    swm_can->errcode = NORMAL;
+    swm_can->lasterrtype = RT_CAN_BUS_NO_ERR;
+    swm181_can_err_update(swm_can);
     
     IRQ_Connect(IRQ0_15_CAN, IRQ4_IRQ, 1);
     NVIC_EnableIRQ(IRQ4_IRQ);
+
+#ifdef BSP_CAN_USING_DMA_RX
+    rt_timer_stop(&swm_can->dma_flush);
+    swm181_can_dma_stop(swm_can);
+    swm181_can_dma_start(swm_can);
+    IRQ_Connect(IRQ0_15_DMA, IRQ13_IRQ, 1);
+    rt_timer_start(&swm_can->dma_flush);
+#endif
     
-    CAN_Open(swm_can->CANx);
+    swm181_can_reset_leave(swm_can);
 
     return RT_EOK;
 }
@@ -66,30 +526,68 @@ static rt_err_t swm181_can_control(struct rt_can_device *can, int cmd, void *arg
     case RT_CAN_CMD_SET_BAUD:
     {
         rt_uint32_t baud = (rt_uint32_t)arg;
-        CAN_Close(swm_can->CANx);
-        CAN_SetBaudrate(swm_can->CANx, baud, CAN_BS1_8tq, CAN_BS2_3tq, CAN_SJW_1tq);
-        CAN_Open(swm_can->CANx);
+        struct swm181_can_timing timing;
+
+        if (swm181_can_calc_timing(SystemCoreClock / 2, baud, BSP_CAN_SAMPLE_POINT, &timing) != RT_EOK)
+            return -RT_ERROR;
+        swm181_can_reset_enter(swm_can);
+        swm181_can_set_timing(swm_can->CANx, &timing);
+        swm181_can_reset_leave(swm_can);
         break;
     }
     case RT_CAN_CMD_SET_MODE:
     {
         rt_uint32_t mode = (rt_uint32_t)arg;
-        CAN_Close(swm_can->CANx);
+        swm181_can_reset_enter(swm_can);
         swm_can->CANx->CR &= ~(CAN_CR_LOM_Msk | CAN_CR_STM_Msk);
         if (mode == RT_CAN_MODE_LISTEN) swm_can->CANx->CR |= (CAN_MODE_LISTEN << CAN_CR_LOM_Pos);
         else if (mode == RT_CAN_MODE_LOOPBACK) swm_can->CANx->CR |= (CAN_MODE_SELFTEST << CAN_CR_STM_Pos);
-        CAN_Open(swm_can->CANx);
+        swm181_can_reset_leave(swm_can);
         break;
     }
     case RT_CAN_CMD_SET_FILTER:
     {
         struct rt_can_filter_config *filter_cfg = (struct rt_can_filter_config *)arg;
-        CAN_Close(swm_can->CANx);
-        if (filter_cfg->count > 0)
-        {
-            CAN_SetFilter32b(swm_can->CANx, filter_cfg->items[0].id, filter_cfg->items[0].mask);
-        }
-        CAN_Open(swm_can->CANx);
+        rt_err_t ret;
+
+        if (filter_cfg == RT_NULL)
+            return -RT_EINVAL;
+
+        /* nothing is received in reset mode, so the ISR never sees a half-built table */
+        swm181_can_reset_enter(swm_can);
+        ret = swm181_can_filter_set(swm_can, filter_cfg);
+        swm181_can_filter_apply(swm_can);
+        swm181_can_reset_leave(swm_can);
+        if (ret != RT_EOK)
+            return ret;
+        break;
+    }
+    case SWM181_CAN_CMD_SET_BACKOFF:
+    {
+        struct swm181_can_backoff *backoff = (struct swm181_can_backoff *)arg;
+        rt_base_t level;
+
+        if (backoff == RT_NULL || backoff->min_ms == 0 || backoff->max_ms < backoff->min_ms)
+            return -RT_EINVAL;
+
+        level = rt_hw_interrupt_disable();
+        swm_can->backoff_min = backoff->min_ms;
+        swm_can->backoff_max = backoff->max_ms;
+        swm_can->backoff_ms = backoff->min_ms;
+        rt_hw_interrupt_enable(level);
+        break;
+    }
+    case SWM181_CAN_CMD_GET_STATS:
+    {
+        rt_base_t level;
+
+        if (arg == RT_NULL)
+            return -RT_EINVAL;
+
+        level = rt_hw_interrupt_disable();
+        swm181_can_err_update(swm_can);
+        rt_memcpy(arg, &swm_can->stats, sizeof(swm_can->stats));
+        rt_hw_interrupt_enable(level);
         break;
     }
     }
@@ -97,17 +595,329 @@ static rt_err_t swm181_can_control(struct rt_can_device *can, int cmd, void *arg
     return RT_EOK;
 }
 
-static int swm181_can_sendmsg(struct rt_can_device *can, const void *buf, rt_uint32_t boxno)
+/* Bits in the order they go on the wire during arbitration: base ID, RTR (standard) or SRR
+ * (extended), IDE, then the 18 extended ID bits and their RTR. Dominant 0 wins. */
+static rt_uint32_t swm181_can_tx_key(const struct rt_can_msg *msg)
 {
-    struct swm181_can *swm_can = (struct swm181_can *)can;
-    struct rt_can_msg *msg = (struct rt_can_msg *)buf;
+    if (msg->ide == RT_CAN_STDID)
+        return ((rt_uint32_t)(msg->id & 0x7FF) << 21) | ((rt_uint32_t)msg->rtr << 20);
+
+    return ((rt_uint32_t)((msg->id >> 18) & 0x7FF) << 21) | (1UL << 20) | (1UL << 19) |
+           ((rt_uint32_t)(msg->id & 0x3FFFF) << 1) | msg->rtr;
+}
+
+static void swm181_can_tx_push(struct swm181_can *swm_can, const struct swm181_can_tx *tx)
+{
+    struct swm181_can_tx *heap = swm_can->tx_heap;
+    int i = swm_can->tx_count++;
+
+    while (i > 0 && heap[(i - 1) / 2].key > tx->key)
+    {
+        heap[i] = heap[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    heap[i] = *tx;
+}
+
+static void swm181_can_tx_pop(struct swm181_can *swm_can, struct swm181_can_tx *tx)
+{
+    struct swm181_can_tx *heap = swm_can->tx_heap;
+    struct swm181_can_tx *last;
+    int i = 0, child;
+
+    *tx = heap[0];
+    last = &heap[--swm_can->tx_count];
+    while ((child = 2 * i + 1) < swm_can->tx_count)
+    {
+        if (child + 1 < swm_can->tx_count && heap[child + 1].key < heap[child].key)
+            child++;
+        if (heap[child].key >= last->key)
+            break;
+        heap[i] = heap[child];
+        i = child;
+    }
+    heap[i] = *last;
+}
+
+/* load tx into the hardware buffer, which must be free */
+static void swm181_can_tx_start(struct swm181_can *swm_can, const struct swm181_can_tx *tx)
+{
+    const struct rt_can_msg *msg = &tx->msg;
     uint32_t format = (msg->ide == RT_CAN_STDID) ? CAN_FRAME_STD : CAN_FRAME_EXT;
 
-    if (!CAN_TXBufferReady(swm_can->CANx)) return -RT_EBUSY;
+    swm_can->tx_cur = *tx;
+    swm_can->tx_busy = RT_TRUE;
+    swm_can->tx_aborting = RT_FALSE;
+
+    if (msg->rtr == RT_CAN_RTR)
+        CAN_TransmitRequest(swm_can->CANx, format, msg->id, 0);
+    else
+        CAN_Transmit(swm_can->CANx, format, msg->id, (uint8_t *)msg->data, msg->len > 8 ? 8 : msg->len, 0);
+}
+
+/* frames of swm181_can_send() are reported to the hook, all others to the device core */
+static void swm181_can_tx_report(struct swm181_can *swm_can, rt_uint32_t box, rt_err_t result)
+{
+    if (box & SWM181_CAN_TX_DIRECT)
+    {
+        if (swm_can->hook.tx_done != RT_NULL)
+            swm_can->hook.tx_done(swm_can->hook.arg, box & ~SWM181_CAN_TX_DIRECT, result);
+    }
+    else
+    {
+        rt_hw_can_isr(&swm_can->parent, (result == RT_EOK ? RT_CAN_EVENT_TX_DONE : RT_CAN_EVENT_TX_FAIL) | (box << 8));
+    }
+}
 
-    CAN_Transmit(swm_can->CANx, format, msg->id, msg->data, msg->len, 0);
+/* Reset mode drops a loaded frame without raising TXBR, and the TX buffer address maps to
+ * the acceptance filter there. A frame still in the buffer goes back into the heap (failed
+ * if the heap is full), one that already left is reported; until swm181_can_reset_leave()
+ * new frames only queue. */
+static void swm181_can_reset_enter(struct swm181_can *swm_can)
+{
+    rt_base_t level;
 
-    return RT_EOK;
+    level = rt_hw_interrupt_disable();
+    swm_can->tx_hold = RT_TRUE;
+    if (swm_can->tx_busy && CAN_TXBufferReady(swm_can->CANx))
+    {
+        swm_can->tx_busy = RT_FALSE;
+        swm181_can_tx_report(swm_can, swm_can->tx_cur.box, CAN_TXSuccess(swm_can->CANx) ? RT_EOK : -RT_EIO);
+    }
+    CAN_Close(swm_can->CANx);
+    if (swm_can->tx_busy)
+    {
+        swm_can->tx_busy = RT_FALSE;
+        if (swm_can->tx_count < BSP_CAN_TX_QUEUE_LEN)
+            swm181_can_tx_push(swm_can, &swm_can->tx_cur);
+        else
+            swm181_can_tx_report(swm_can, swm_can->tx_cur.box, -RT_EIO);
+    }
+    rt_hw_interrupt_enable(level);
+}
+
+/* back to operating mode, load whatever queued up meanwhile */
+static void swm181_can_reset_leave(struct swm181_can *swm_can)
+{
+    struct swm181_can_tx next;
+    rt_base_t level;
+
+    level = rt_hw_interrupt_disable();
+    CAN_Open(swm_can->CANx);
+    swm_can->tx_hold = RT_FALSE;
+    if (!swm_can->tx_busy && !swm_can->bus_off && swm_can->tx_count != 0 && CAN_TXBufferReady(swm_can->CANx))
+    {
+        swm181_can_tx_pop(swm_can, &next);
+        swm181_can_tx_start(swm_can, &next);
+    }
+    rt_hw_interrupt_enable(level);
+}
+
+/* TXBR interrupt: report the frame that left the buffer and load the next one */
+static void swm181_can_tx_isr(struct swm181_can *swm_can)
+{
+    struct swm181_can_tx next;
+
+    if (!swm_can->tx_busy)
+        return;
+    swm_can->tx_busy = RT_FALSE;
+
+    if (CAN_TXSuccess(swm_can->CANx))
+    {
+        /* the bus carries frames again, the next bus-off starts from the shortest backoff */
+        if (swm_can->recovered)
+        {
+            swm_can->recovered = RT_FALSE;
+            swm_can->backoff_ms = swm_can->backoff_min;
+        }
+        swm181_can_tx_report(swm_can, swm_can->tx_cur.box, RT_EOK);
+    }
+    else if (swm_can->tx_aborting)
+    {
+        /* preempted, not failed: queue it again behind the urgent frame */
+        swm181_can_tx_push(swm_can, &swm_can->tx_cur);
+    }
+    else
+    {
+        swm181_can_tx_report(swm_can, swm_can->tx_cur.box, -RT_EIO);
+    }
+
+    /* the hook may have loaded a frame already */
+    if (!swm_can->tx_busy && !swm_can->tx_hold && !swm_can->bus_off && swm_can->tx_count != 0)
+    {
+        swm181_can_tx_pop(swm_can, &next);
+        swm181_can_tx_start(swm_can, &next);
+    }
+}
+
+/* Bus-off: the controller has gone to reset mode, where the TX buffer address maps to the
+ * acceptance filter, so nothing may be loaded until recovery ends. Writers would wait out the
+ * whole backoff, fail their frames instead. */
+static void swm181_can_bus_off(struct swm181_can *swm_can)
+{
+    struct swm181_can_tx tx;
+    rt_tick_t tick;
+
+    swm_can->bus_off = RT_TRUE;
+    swm_can->recovered = RT_FALSE;
+    swm_can->stats.bus_offs++;
+    CAN_Close(swm_can->CANx);
+
+    if (swm_can->tx_busy)
+    {
+        swm_can->tx_busy = RT_FALSE;
+        swm181_can_tx_report(swm_can, swm_can->tx_cur.box, -RT_EIO);
+    }
+    while (swm_can->tx_count != 0)
+    {
+        swm181_can_tx_pop(swm_can, &tx);
+        swm181_can_tx_report(swm_can, tx.box, -RT_EIO);
+    }
+
+    tick = rt_tick_from_millisecond(swm_can->backoff_ms);
+    if (tick == 0)
+        tick = 1;
+    rt_timer_control(&swm_can->bus_on, RT_TIMER_CTRL_SET_TIME, &tick);
+    rt_timer_start(&swm_can->bus_on);
+
+    swm_can->backoff_ms = (swm_can->backoff_ms > swm_can->backoff_max / 2) ? swm_can->backoff_max : swm_can->backoff_ms * 2;
+}
+
+/* backoff over: leaving reset mode starts the 128 x 11 recessive bit recovery, the ERRWARN
+ * interrupt reports its end */
+static void swm181_can_bus_on(void *parameter)
+{
+    struct swm181_can *swm_can = (struct swm181_can *)parameter;
+
+    if (swm_can->bus_off)
+        CAN_Open(swm_can->CANx);
+}
+
+/* Reads the error counters and state. RT_CAN_CMD_GET_STATUS is answered by the device core
+ * without asking the driver, and it unpacks status.rcverrcnt as REC << 24 | TEC << 16 |
+ * lasterrtype << 4 | errcode, so that word is kept packed; it is refreshed on every CAN
+ * interrupt. The status_indicate callback runs on every state change. */
+static void swm181_can_err_update(struct swm181_can *swm_can)
+{
+    struct rt_can_status *status = &swm_can->parent.status;
+    rt_uint32_t sr = swm_can->CANx->SR;
+    rt_uint32_t rec = swm_can->CANx->RXERR & 0xFF;
+    rt_uint32_t tec = swm_can->CANx->TXERR & 0xFF;
+    rt_uint32_t errcode = NORMAL;
+
+    if (sr & CAN_SR_ERRWARN_Msk)
+        errcode |= ERRWARNING;
+    if (rec > 127 || tec > 127)
+        errcode |= ERRPASSIVE;
+    if (sr & CAN_SR_BUSOFF_Msk)
+        errcode |= BUSOFF;
+
+    status->rcverrcnt = (rec << 24) | (tec << 16) | ((swm_can->lasterrtype << 4) & 0x70) | (errcode & 0x07);
+    status->snderrcnt = tec;
+    status->errcode = errcode;
+    status->lasterrtype = (swm_can->lasterrtype << 4) & 0x70;
+    swm_can->stats.rec = rec;
+    swm_can->stats.tec = tec;
+    swm_can->stats.errcode = errcode;
+
+    if (errcode == swm_can->errcode)
+        return;
+    swm_can->errcode = errcode;
+    swm_can->stats.state_changes++;
+
+    if ((errcode & BUSOFF) && !swm_can->bus_off)
+    {
+        swm181_can_bus_off(swm_can);
+    }
+    else if (!(errcode & BUSOFF) && swm_can->bus_off)
+    {
+        swm_can->bus_off = RT_FALSE;
+        swm_can->recovered = RT_TRUE;
+    }
+
+    if (swm_can->parent.status_indicate.ind != RT_NULL)
+        swm_can->parent.status_indicate.ind(&swm_can->parent, swm_can->parent.status_indicate.args);
+}
+
+/* BUSERR interrupt: classify the error captured in ECC, reading it arms the next capture */
+static void swm181_can_bus_err(struct swm181_can *swm_can)
+{
+    struct rt_can_status *status = &swm_can->parent.status;
+    rt_uint32_t ecc = swm_can->CANx->ECC;
+    rt_uint32_t seg = (ecc & CAN_ECC_SEGCODE_Msk) >> CAN_ECC_SEGCODE_Pos;
+
+    switch ((ecc & CAN_ECC_ERRCODE_Msk) >> CAN_ECC_ERRCODE_Pos)
+    {
+    case 0:
+        /* ECC has no bit level: a receiver only drives dominant bits (ACK, error flag) */
+        status->biterrcnt++;
+        swm_can->lasterrtype = (ecc & CAN_ECC_DIR_Msk) ? RT_CAN_BUS_EXPLICIT_BIT_ERR : RT_CAN_BUS_IMPLICIT_BIT_ERR;
+        break;
+    case 1:
+        status->formaterrcnt++;
+        swm_can->lasterrtype = RT_CAN_BUS_FORMAT_ERR;
+        break;
+    case 2:
+        status->bitpaderrcnt++;
+        swm_can->lasterrtype = RT_CAN_BUS_BIT_PAD_ERR;
+        break;
+    default:
+        if (seg == 0x19 || seg == 0x1B)         /* ACK slot, ACK delimiter */
+        {
+            status->ackerrcnt++;
+            swm_can->lasterrtype = RT_CAN_BUS_ACK_ERR;
+        }
+        else if (seg == 0x08 || seg == 0x18)    /* CRC sequence, CRC delimiter */
+        {
+            status->crcerrcnt++;
+            swm_can->lasterrtype = RT_CAN_BUS_CRC_ERR;
+        }
+        break;
+    }
+}
+
+static rt_err_t swm181_can_tx_submit(struct swm181_can *swm_can, const struct rt_can_msg *msg, rt_uint32_t box)
+{
+    struct swm181_can_tx tx;
+    rt_base_t level;
+    rt_err_t ret = RT_EOK;
+
+    tx.msg = *msg;
+    tx.key = swm181_can_tx_key(&tx.msg);
+    tx.box = box;
+
+    level = rt_hw_interrupt_disable();
+    if (swm_can->bus_off)
+    {
+        ret = -RT_ERROR;
+    }
+    else if (!swm_can->tx_busy && !swm_can->tx_hold && CAN_TXBufferReady(swm_can->CANx))
+    {
+        swm181_can_tx_start(swm_can, &tx);
+    }
+    else if (swm_can->tx_count < BSP_CAN_TX_QUEUE_LEN)
+    {
+        swm181_can_tx_push(swm_can, &tx);
+#ifdef BSP_CAN_TX_PREEMPT
+        if (swm_can->tx_busy && !swm_can->tx_aborting && tx.key < swm_can->tx_cur.key)
+        {
+            swm_can->tx_aborting = RT_TRUE;
+            CAN_AbortTransmit(swm_can->CANx);
+        }
+#endif
+    }
+    else
+    {
+        ret = -RT_EBUSY;
+    }
+    rt_hw_interrupt_enable(level);
+
+    return ret;
+}
+
+static int swm181_can_sendmsg(struct rt_can_device *can, const void *buf, rt_uint32_t boxno)
+{
+    return swm181_can_tx_submit((struct swm181_can *)can, (const struct rt_can_msg *)buf, boxno);
 }
 
 static int swm181_can_recvmsg(struct rt_can_device *can, void *buf, rt_uint32_t boxno)
@@ -116,19 +926,73 @@ static int swm181_can_recvmsg(struct rt_can_device *can, void *buf, rt_uint32_t
     struct rt_can_msg *msg = (struct rt_can_msg *)buf;
     CAN_RXMessage rx_msg;
 
-    if (!CAN_RXDataAvailable(swm_can->CANx)) return -1;
+    /* frames the software table rejects never reach the RX FIFO of the device */
+    do
+    {
+#ifdef BSP_CAN_USING_DMA_RX
+        /* the ring holds the older frames, the controller FIFO is only read in fallback */
+        if (swm181_can_dma_ready(swm_can))
+        {
+            struct swm181_can_raw *raw = &can_dma_ring[swm_can->dma_rd];
+
+            swm181_can_decode(&raw->info, raw->data, &rx_msg);
+            raw->data[SWM181_CAN_DMA_WORDS - 2] = SWM181_CAN_DMA_EMPTY;
+            swm_can->dma_rd = (swm_can->dma_rd + 1) % SWM181_CAN_DMA_FRAMES;
+        }
+        else if (!swm_can->dma_fallback)
+        {
+            /* the channel owns CAN->FRAME, reading it here would tear its next copy */
+            return -1;
+        }
+        else
+#endif
+        {
+            if (!CAN_RXDataAvailable(swm_can->CANx)) return -1;
+
+            CAN_Receive(swm_can->CANx, &rx_msg);
+        }
+        if (!swm181_can_filter_match(swm_can, SWM181_CAN_KEY(rx_msg.format == CAN_FRAME_EXT, rx_msg.remote, rx_msg.id)))
+        {
+            swm_can->stats.filter_drops++;
+            continue;
+        }
 
-    CAN_Receive(swm_can->CANx, &rx_msg);
+        msg->id = rx_msg.id;
+        msg->ide = (rx_msg.format == CAN_FRAME_STD) ? RT_CAN_STDID : RT_CAN_EXTID;
+        msg->rtr = (rx_msg.remote) ? RT_CAN_RTR : RT_CAN_DTR;
+        msg->len = rx_msg.size;
+        rt_memcpy(msg->data, rx_msg.data, rx_msg.size);
 
-    msg->id = rx_msg.id;
-    msg->ide = (rx_msg.format == CAN_FRAME_STD) ? RT_CAN_STDID : RT_CAN_EXTID;
-    msg->rtr = (rx_msg.remote) ? RT_CAN_RTR : RT_CAN_DTR;
-    msg->len = rx_msg.size;
-    rt_memcpy(msg->data, rx_msg.data, rx_msg.size);
+        /* frames the hook consumes are not queued for the device either */
+        if (swm_can->hook.rx == RT_NULL || !swm_can->hook.rx(swm_can->hook.arg, msg))
+            break;
+    } while (1);
 
     return RT_EOK;
 }
 
+void swm181_can_hook_set(const struct swm181_can_hook *hook)
+{
+    rt_base_t level;
+
+    level = rt_hw_interrupt_disable();
+    if (hook != RT_NULL)
+        can_obj.hook = *hook;
+    else
+        rt_memset(&can_obj.hook, 0, sizeof(can_obj.hook));
+    rt_hw_interrupt_enable(level);
+}
+
+/* Queues msg behind frames of higher priority like a device write, but returns at once and
+ * from any context. The outcome goes to hook.tx_done with tag, unless the queue is full. */
+rt_err_t swm181_can_send(const struct rt_can_msg *msg, rt_uint32_t tag)
+{
+    if (tag & SWM181_CAN_TX_DIRECT)
+        return -RT_EINVAL;
+
+    return swm181_can_tx_submit(&can_obj, msg, SWM181_CAN_TX_DIRECT | tag);
+}
+
 static const struct rt_can_ops swm181_can_ops =
 {
     swm181_can_configure,
@@ -142,13 +1006,42 @@ void IRQ4_Handler(void)
     rt_interrupt_enter();
     uint32_t status = CAN_INTStat(CAN);
 
+    /* the error state goes first, after a bus-off the TX buffer must not be reloaded */
+    if (status & CAN_IF_BUSERR_Msk)
+    {
+        swm181_can_bus_err(&can_obj);
+    }
+    if (status & CAN_IF_ARBLOST_Msk)
+    {
+        (void)CAN->ALC;
+        can_obj.stats.arb_lost++;
+    }
+    if (status & CAN_IF_WKUP_Msk)
+    {
+        can_obj.stats.wakeups++;
+    }
+    /* counters also move on frames that went well, keep GET_STATUS current */
+    swm181_can_err_update(&can_obj);
+    if (status & CAN_IF_RXOV_Msk)
+    {
+        CAN_INTRXOverflowClear(CAN);
+        can_obj.stats.rx_overruns++;
+        rt_hw_can_isr(&can_obj.parent, RT_CAN_EVENT_RXOF_IND | (0 << 8));
+    }
     if (status & CAN_IF_RXDA_Msk)
     {
+#ifdef BSP_CAN_USING_DMA_RX
+        /* only enabled in fallback, frames still in the ring go first */
+        swm181_can_dma_deliver(&can_obj);
+        if (can_obj.dma_fallback)
+            rt_hw_can_isr(&can_obj.parent, RT_CAN_EVENT_RX_IND | (0 << 8));
+#else
         rt_hw_can_isr(&can_obj.parent, RT_CAN_EVENT_RX_IND | (0 << 8));
+#endif
     }
     if (status & CAN_IF_TXBR_Msk)
     {
-        rt_hw_can_isr(&can_obj.parent, RT_CAN_EVENT_TX_DONE | (0 << 8));
+        swm181_can_tx_isr(&can_obj);
     }
     
     rt_interrupt_leave();
@@ -173,6 +1066,24 @@ int rt_hw_can_init(void)
     PORT_Init(SWM181_PIN_GET_PORT_PTR(rx_pin), SWM181_PIN_GET_PIN_IDX(rx_pin), FUNMUX_CAN_RX, 1);
     PORT_Init(SWM181_PIN_GET_PORT_PTR(tx_pin), SWM181_PIN_GET_PIN_IDX(tx_pin), FUNMUX_CAN_TX, 0);
 
+    can_obj.backoff_min = BSP_CAN_BUSOFF_BACKOFF_MS;
+    can_obj.backoff_max = BSP_CAN_BUSOFF_BACKOFF_MAX_MS;
+    rt_timer_init(&can_obj.bus_on, "canbo", swm181_can_bus_on, &can_obj, 1,
+                  RT_TIMER_FLAG_ONE_SHOT | RT_TIMER_FLAG_HARD_TIMER);
+#ifdef BSP_CAN_USING_DMA_RX
+    rt_timer_init(&can_obj.dma_flush, "candma", swm181_can_dma_flush, &can_obj,
+                  rt_tick_from_millisecond(BSP_CAN_DMA_FLUSH_MS) ? rt_tick_from_millisecond(BSP_CAN_DMA_FLUSH_MS) : 1,
+                  RT_TIMER_FLAG_PERIODIC | RT_TIMER_FLAG_HARD_TIMER);
+#endif
+
+    {
+        struct can_configure config = CANDEFAULTCONFIG;
+
+        /* every send box can wait in the TX heap */
+        config.sndboxnumber = BSP_CAN_TX_QUEUE_LEN;
+        can_obj.parent.config = config;
+    }
+
     return rt_hw_can_register(&can_obj.parent, can_obj.name, &swm181_can_ops, RT_NULL);
 }
 INIT_DEVICE_EXPORT(rt_hw_can_init);
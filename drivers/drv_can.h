@@ -14,6 +14,57 @@
 #include <rtthread.h>
 #include <rtdevice.h>
 
+/* register values for BT0 / BT1, each field is the hardware count minus one */
+struct swm181_can_timing
+{
+    rt_uint8_t brp;             /* prescaler, tq = 2 * (brp + 1) / SystemCoreClock */
+    rt_uint8_t bs1;             /* CAN_BS1_xtq */
+    rt_uint8_t bs2;             /* CAN_BS2_xtq */
+    rt_uint8_t sjw;             /* CAN_SJW_xtq */
+    rt_uint32_t bitrate;        /* achieved */
+    rt_uint16_t sample_point;   /* achieved, permille */
+    rt_int32_t error_ppm;       /* (achieved - requested) / requested */
+};
+
+/* rt_device_control() commands of "can1", besides the RT_CAN_CMD_xxx ones */
+#define SWM181_CAN_CMD_SET_BACKOFF  (RT_DEVICE_CTRL_BASE(CAN) + 0x20)     /* arg: struct swm181_can_backoff * */
+#define SWM181_CAN_CMD_GET_STATS    (RT_DEVICE_CTRL_BASE(CAN) + 0x21)     /* arg: struct swm181_can_stats * */
+
+/* delay before recovery from bus-off starts, doubled per bus-off in a row */
+struct swm181_can_backoff
+{
+    rt_uint32_t min_ms;
+    rt_uint32_t max_ms;
+};
+
+/* events the device core has no counter for, reset when the device is opened */
+struct swm181_can_stats
+{
+    rt_uint32_t filter_drops;   /* frames rejected by the software filter table */
+    rt_uint32_t dma_overruns;   /* DMA ring full, fell back to the RXDA interrupt */
+    rt_uint32_t rx_overruns;    /* controller FIFO overflowed, frames lost */
+    rt_uint32_t arb_lost;       /* arbitration lost, the frame is retried by the hardware */
+    rt_uint32_t bus_offs;
+    rt_uint32_t wakeups;
+    rt_uint32_t state_changes;  /* error state transitions */
+    rt_uint32_t tec;            /* transmit / receive error counters, read fresh by GET_STATS */
+    rt_uint32_t rec;
+    rt_uint32_t errcode;        /* RT_CAN_STATUS_MODE bits */
+};
+
+/* Runs a protocol layer in the CAN interrupt, next to the device core's FIFOs. Both
+ * callbacks are called from the ISR. */
+struct swm181_can_hook
+{
+    rt_bool_t (*rx)(void *arg, const struct rt_can_msg *msg);       /* RT_TRUE: consumed, not queued for read */
+    void (*tx_done)(void *arg, rt_uint32_t tag, rt_err_t result);   /* a frame of swm181_can_send() left or failed */
+    void *arg;
+};
+
+rt_err_t swm181_can_calc_timing(rt_uint32_t clk, rt_uint32_t bitrate, rt_uint16_t sample_point,
+                                struct swm181_can_timing *t);
+void swm181_can_hook_set(const struct swm181_can_hook *hook);
+rt_err_t swm181_can_send(const struct rt_can_msg *msg, rt_uint32_t tag);
 int rt_hw_can_init(void);
 
 #endif
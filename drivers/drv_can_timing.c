@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) 2006-2022, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ */
+
+#include <rtthread.h>
+#include "drv_can.h"
+
+/* Pure arithmetic, kept apart from drv_can.c so tests/can_timing can run it on the host. */
+
+/* Closest bit timing to bitrate for a controller clocked at clk (SystemCoreClock / 2), with the
+ * sample point as near to sample_point (permille, 0 for 875) as the segment limits allow.
+ * Candidates are ranked by bitrate error, then sample point error, then more time quanta.
+ * Returns -RT_ERROR, with t still filled in, when the best rate is off by more than 0.5%. */
+rt_err_t swm181_can_calc_timing(rt_uint32_t clk, rt_uint32_t bitrate, rt_uint16_t sample_point,
+                                struct swm181_can_timing *t)
+{
+    rt_uint32_t ntq, brp, bs1, bs2, rate, err, sp, sp_err;
+    rt_uint32_t best_err = 0xFFFFFFFF, best_sp_err = 0xFFFFFFFF;
+
+    if (bitrate == 0 || t == RT_NULL)
+        return -RT_EINVAL;
+    if (sample_point == 0 || sample_point >= 1000)
+        sample_point = 875;
+
+    /* a bit is SYNC (1 tq) + BS1 (1..16) + BS2 (1..8), the prescaler runs 1..64 */
+    for (ntq = 25; ntq >= 3; ntq--)
+    {
+        brp = (clk + bitrate * ntq / 2) / (bitrate * ntq);
+        if (brp < 1)
+            brp = 1;
+        if (brp > 64)
+            brp = 64;
+
+        rate = clk / (brp * ntq);
+        err = (rate > bitrate) ? rate - bitrate : bitrate - rate;
+
+        bs2 = (ntq * (1000 - sample_point) + 500) / 1000;
+        if (bs2 < 1)
+            bs2 = 1;
+        if (bs2 > 8)
+            bs2 = 8;
+        bs1 = ntq - 1 - bs2;
+        if (bs1 > 16)
+        {
+            bs1 = 16;
+            bs2 = ntq - 1 - bs1;
+            if (bs2 > 8)
+                continue;
+        }
+        if (bs1 < 1)
+            continue;
+
+        sp = (1 + bs1) * 1000 / ntq;
+        sp_err = (sp > sample_point) ? sp - sample_point : sample_point - sp;
+
+        if (err < best_err || (err == best_err && sp_err < best_sp_err))
+        {
+            best_err = err;
+            best_sp_err = sp_err;
+            t->brp = brp - 1;
+            t->bs1 = bs1 - 1;
+            t->bs2 = bs2 - 1;
+            t->sjw = ((bs2 < 4) ? bs2 : 4) - 1;
+            t->bitrate = rate;
+            t->sample_point = sp;
+            t->error_ppm = (rt_int32_t)(((rt_int64_t)rate - bitrate) * 1000000 / bitrate);
+        }
+    }
+
+    if (best_err == 0xFFFFFFFF)
+        return -RT_ERROR;
+
+    return (best_err * 200 > bitrate) ? -RT_ERROR : RT_EOK;
+}
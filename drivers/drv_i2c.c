@@ -20,6 +20,24 @@
 #error "Please define at least one BSP_USING_I2Cx"
 #endif
 
+/* what the byte controller is doing while MSTCMD.TIP is set */
+enum swm181_i2c_state
+{
+    I2C_STATE_IDLE,
+    I2C_STATE_ADDR,     /* START + address byte */
+    I2C_STATE_WRITE,
+    I2C_STATE_READ,
+    I2C_STATE_STOP,
+};
+
+#if defined(BSP_I2C0_SLAVE) || defined(BSP_I2C1_SLAVE)
+#define SWM181_I2C_USING_SLAVE
+#endif
+
+#define SWM181_I2C_DEFAULT_CLK  100000
+/* slaves that can have their own SCL rate */
+#define SWM181_I2C_DEV_CLK_MAX  8
+
 struct swm181_i2c_bus
 {
     struct rt_i2c_bus_device parent;
@@ -27,11 +45,364 @@ struct swm181_i2c_bus
     const char *name;
     const char *scl_pin_name;
     const char *sda_pin_name;
+    IRQn_Type irqn;
+    rt_uint32_t periph_irq;
+    rt_base_t scl_pin;
+    rt_base_t sda_pin;
+
+    /* interrupt driven transfer, owned by the ISR between start and completion */
+    struct rt_completion done;
+    struct rt_i2c_msg *msgs;
+    rt_uint32_t num;
+    rt_uint32_t idx;            /* message in progress */
+    rt_uint32_t pos;            /* byte in progress within msgs[idx] */
+    rt_uint8_t state;
+    rt_ssize_t result;          /* messages completed, valid once done fires */
+
+    rt_uint32_t clk;            /* SCL rate for slaves without an entry in dev_clk[] */
+    rt_uint32_t cur_clk;        /* what CLKDIV is programmed for */
+    struct swm181_i2c_dev_clk dev_clk[SWM181_I2C_DEV_CLK_MAX];     /* hz == 0: free slot */
+    struct swm181_i2c_slave *slave;     /* not RT_NULL: the port runs as a slave, no bus is registered */
 };
 
-static rt_ssize_t swm181_i2c_master_xfer(struct rt_i2c_bus_device *bus, struct rt_i2c_msg msgs[], rt_uint32_t num)
+struct swm181_i2c_slave
+{
+    struct rt_device parent;
+    struct swm181_i2c_bus *bus;
+    const char *name;
+    rt_uint16_t addr;
+    struct swm181_i2cs_map map;
+    rt_uint16_t ptr;            /* register the host accesses next */
+    rt_bool_t reg_phase;        /* the next byte written by the host is a register index */
+};
+
+/* The IF flag shares MSTCMD with the command bits, and BUSY / RXACK read back in the STO / STA
+ * positions, so I2C_INTClr()'s read-modify-write could issue a stray STOP or START. Clear it
+ * with a plain write instead. */
+#define SWM181_I2C_INT_CLR(I2Cx)    ((I2Cx)->MSTCMD = I2C_MSTCMD_IF_Msk)
+
+#ifdef BSP_I2C0_SLAVE
+static struct swm181_i2c_slave i2cs0 = { .name = "i2cs0", .addr = BSP_I2C0_SLAVE_ADDR };
+#define I2C0_SLAVE &i2cs0
+#else
+#define I2C0_SLAVE RT_NULL
+#endif
+#ifdef BSP_I2C1_SLAVE
+static struct swm181_i2c_slave i2cs1 = { .name = "i2cs1", .addr = BSP_I2C1_SLAVE_ADDR };
+#define I2C1_SLAVE &i2cs1
+#else
+#define I2C1_SLAVE RT_NULL
+#endif
+
+static struct swm181_i2c_bus i2c_objs[] = {
+#ifdef BSP_USING_I2C0
+    { .I2Cx = I2C0, .name = "i2c0", .scl_pin_name = BSP_I2C0_SCL_PIN, .sda_pin_name = BSP_I2C0_SDA_PIN,
+      .irqn = IRQ11_IRQ, .periph_irq = IRQ0_15_I2C0, .slave = I2C0_SLAVE },
+#endif
+#ifdef BSP_USING_I2C1
+    { .I2Cx = I2C1, .name = "i2c1", .scl_pin_name = BSP_I2C1_SCL_PIN, .sda_pin_name = BSP_I2C1_SDA_PIN,
+      .irqn = IRQ12_IRQ, .periph_irq = IRQ0_15_I2C1, .slave = I2C1_SLAVE },
+#endif
+};
+
+#ifdef SWM181_I2C_USING_SLAVE
+/* value the host reads from register ptr, 0xFF past the end of the map */
+static rt_uint8_t swm181_i2c_slave_load(struct swm181_i2c_slave *slave)
+{
+    struct swm181_i2cs_map *map = &slave->map;
+    rt_uint16_t r = slave->ptr;
+    rt_uint8_t val;
+
+    if (r >= map->size)
+        return 0xFF;
+
+    val = map->regs[r];
+    if (map->reg != RT_NULL && map->reg[r].read != RT_NULL)
+        val = map->reg[r].read((rt_uint8_t)r, val, map->arg);
+
+    return val;
+}
+
+static void swm181_i2c_slave_store(struct swm181_i2c_slave *slave, rt_uint8_t val)
+{
+    struct swm181_i2cs_map *map = &slave->map;
+    rt_uint16_t r = slave->ptr;
+
+    if (slave->reg_phase)
+    {
+        slave->ptr = val;
+        slave->reg_phase = RT_FALSE;
+        return;
+    }
+
+    if (r >= map->size)
+        return;
+    slave->ptr++;
+
+    if (map->reg != RT_NULL && (map->reg[r].flags & SWM181_I2CS_REG_RO))
+        return;
+
+    map->regs[r] = val;
+    if (map->reg != RT_NULL && map->reg[r].write != RT_NULL)
+        map->reg[r].write((rt_uint8_t)r, val, map->arg);
+}
+
+/* every register access is answered here, so a host read never waits for a thread */
+static void swm181_i2c_slave_isr(struct swm181_i2c_slave *slave)
+{
+    I2C_TypeDef *I2Cx = slave->bus->I2Cx;
+    rt_uint32_t flags = I2Cx->SLVIF;
+
+    if (flags & I2C_SLVIF_WRREQ_Msk)
+    {
+        I2Cx->SLVIF = I2C_SLVIF_WRREQ_Msk;
+        slave->reg_phase = RT_TRUE;
+    }
+
+    if (flags & I2C_SLVIF_RXEND_Msk)
+    {
+        I2Cx->SLVIF = I2C_SLVIF_RXEND_Msk;
+        swm181_i2c_slave_store(slave, (rt_uint8_t)I2Cx->SLVRX);
+    }
+
+    if (flags & I2C_SLVIF_RDREQ_Msk)
+    {
+        I2Cx->SLVIF = I2C_SLVIF_RDREQ_Msk;
+        I2Cx->SLVTX = swm181_i2c_slave_load(slave);
+    }
+    else if (flags & I2C_SLVIF_TXEND_Msk)
+    {
+        /* the byte of ptr went out, prefetch the next one; the host may NACK and never read it */
+        I2Cx->SLVIF = I2C_SLVIF_TXEND_Msk;
+        if (slave->ptr < slave->map.size)
+            slave->ptr++;
+        I2Cx->SLVTX = swm181_i2c_slave_load(slave);
+    }
+}
+#endif /* SWM181_I2C_USING_SLAVE */
+
+/* issue the next byte-level command for bus->msgs[], or complete the transfer */
+static void swm181_i2c_next(struct swm181_i2c_bus *bus)
+{
+    I2C_TypeDef *I2Cx = bus->I2Cx;
+    struct rt_i2c_msg *msg;
+
+    while (bus->idx < bus->num)
+    {
+        msg = &bus->msgs[bus->idx];
+
+        if (bus->state == I2C_STATE_IDLE)
+        {
+            bus->pos = 0;
+            if ((msg->flags & RT_I2C_NO_START) == 0)
+            {
+                /* a START with no STOP before it is a repeated start */
+                I2Cx->MSTDAT = ((msg->addr & 0x7FU) << 1) | ((msg->flags & RT_I2C_RD) ? 1U : 0U);
+                I2Cx->MSTCMD = I2C_MSTCMD_STA_Msk | I2C_MSTCMD_WR_Msk;
+                bus->state = I2C_STATE_ADDR;
+                return;
+            }
+        }
+
+        if (bus->pos < msg->len)
+        {
+            if (msg->flags & RT_I2C_RD)
+            {
+                rt_bool_t nack = (msg->flags & RT_I2C_NO_READ_ACK) || (bus->pos + 1U) == msg->len;
+
+                I2Cx->MSTCMD = I2C_MSTCMD_RD_Msk | (nack ? I2C_MSTCMD_ACK_Msk : 0);
+                bus->state = I2C_STATE_READ;
+            }
+            else
+            {
+                I2Cx->MSTDAT = msg->buf[bus->pos];
+                I2Cx->MSTCMD = I2C_MSTCMD_WR_Msk;
+                bus->state = I2C_STATE_WRITE;
+            }
+            return;
+        }
+
+        /* message done */
+        bus->idx++;
+        bus->result = bus->idx;
+        if ((msg->flags & RT_I2C_NO_STOP) == 0)
+        {
+            I2Cx->MSTCMD = I2C_MSTCMD_STO_Msk;
+            bus->state = I2C_STATE_STOP;
+            return;
+        }
+        bus->state = I2C_STATE_IDLE;
+    }
+
+    bus->state = I2C_STATE_IDLE;
+    rt_completion_done(&bus->done);
+}
+
+static void swm181_i2c_isr(struct swm181_i2c_bus *bus)
+{
+    I2C_TypeDef *I2Cx = bus->I2Cx;
+    struct rt_i2c_msg *msg;
+    rt_bool_t nack;
+
+#ifdef SWM181_I2C_USING_SLAVE
+    if (bus->slave != RT_NULL)
+    {
+        swm181_i2c_slave_isr(bus->slave);
+        return;
+    }
+#endif
+
+    if (!I2C_INTStat(I2Cx))
+        return;
+    SWM181_I2C_INT_CLR(I2Cx);
+
+    /* msgs[idx] only exists while a message is in progress, idx == num once the STOP is out */
+    switch (bus->state)
+    {
+    case I2C_STATE_ADDR:
+    case I2C_STATE_WRITE:
+        msg = &bus->msgs[bus->idx];
+        nack = (I2Cx->MSTCMD & I2C_MSTCMD_RXACK_Msk) && (msg->flags & RT_I2C_IGNORE_NACK) == 0;
+        if (nack)
+        {
+            /* abort: the return value counts the messages that went through */
+            bus->num = bus->idx;
+            I2Cx->MSTCMD = I2C_MSTCMD_STO_Msk;
+            bus->state = I2C_STATE_STOP;
+            return;
+        }
+        if (bus->state == I2C_STATE_WRITE)
+            bus->pos++;
+        break;
+
+    case I2C_STATE_READ:
+        msg = &bus->msgs[bus->idx];
+        msg->buf[bus->pos++] = I2Cx->MSTDAT;
+        break;
+
+    case I2C_STATE_STOP:
+        bus->state = I2C_STATE_IDLE;
+        break;
+
+    default:
+        return;
+    }
+
+    swm181_i2c_next(bus);
+}
+
+#ifdef BSP_USING_I2C0
+void IRQ11_Handler(void)
+{
+    rt_interrupt_enter();
+    swm181_i2c_isr(&i2c_objs[0]);
+    rt_interrupt_leave();
+}
+#endif
+
+#ifdef BSP_USING_I2C1
+void IRQ12_Handler(void)
+{
+    rt_interrupt_enter();
+    int idx = 0;
+#ifdef BSP_USING_I2C0
+    idx++;
+#endif
+    swm181_i2c_isr(&i2c_objs[idx]);
+    rt_interrupt_leave();
+}
+#endif
+
+/* about a quarter SCL period at 100 kHz, each pass of the loop takes a few cycles */
+static void swm181_i2c_recover_delay(void)
+{
+    volatile rt_uint32_t n = SystemCoreClock / 4 / 400000;
+
+    while (n--);
+}
+
+/* After a timeout TIP cannot be trusted: a slave stretching SCL or stuck in the middle of a
+ * byte keeps it set for good. Give a byte in flight a bounded chance to finish, then disable
+ * the controller, clock SCL by hand until the slave releases SDA, send a STOP and hand the
+ * pins back. */
+static void swm181_i2c_recover(struct swm181_i2c_bus *bus)
+{
+    I2C_TypeDef *I2Cx = bus->I2Cx;
+    rt_uint32_t n = SystemCoreClock / bus->cur_clk * 10;
+    uint32_t scl_func = (I2Cx == I2C0) ? FUNMUX_I2C0_SCL : FUNMUX_I2C1_SCL;
+    uint32_t sda_func = (I2Cx == I2C0) ? FUNMUX_I2C0_SDA : FUNMUX_I2C1_SDA;
+    int i;
+
+    while ((I2Cx->MSTCMD & I2C_MSTCMD_TIP_Msk) && n--);
+
+    I2C_Close(I2Cx);
+
+    rt_pin_write(bus->scl_pin, PIN_HIGH);
+    rt_pin_write(bus->sda_pin, PIN_HIGH);
+    rt_pin_mode(bus->scl_pin, PIN_MODE_OUTPUT_OD);
+    rt_pin_mode(bus->sda_pin, PIN_MODE_OUTPUT_OD);
+    swm181_i2c_recover_delay();
+
+    for (i = 0; i < 9 && rt_pin_read(bus->sda_pin) == PIN_LOW; i++)
+    {
+        rt_pin_write(bus->scl_pin, PIN_LOW);
+        swm181_i2c_recover_delay();
+        rt_pin_write(bus->scl_pin, PIN_HIGH);
+        swm181_i2c_recover_delay();
+    }
+
+    /* STOP: SDA rises while SCL is high */
+    rt_pin_write(bus->scl_pin, PIN_LOW);
+    swm181_i2c_recover_delay();
+    rt_pin_write(bus->sda_pin, PIN_LOW);
+    swm181_i2c_recover_delay();
+    rt_pin_write(bus->scl_pin, PIN_HIGH);
+    swm181_i2c_recover_delay();
+    rt_pin_write(bus->sda_pin, PIN_HIGH);
+    swm181_i2c_recover_delay();
+
+    PORT_Init(SWM181_PIN_GET_PORT_PTR(bus->scl_pin), SWM181_PIN_GET_PIN_IDX(bus->scl_pin), scl_func, 1);
+    PORT_Init(SWM181_PIN_GET_PORT_PTR(bus->sda_pin), SWM181_PIN_GET_PIN_IDX(bus->sda_pin), sda_func, 1);
+    I2C_Open(I2Cx);
+}
+
+/* the calling thread sleeps while the ISR walks through msgs[] */
+static rt_ssize_t swm181_i2c_xfer_int(struct swm181_i2c_bus *bus, struct rt_i2c_msg msgs[], rt_uint32_t num)
+{
+    I2C_TypeDef *I2Cx = bus->I2Cx;
+    rt_int32_t timeout = bus->parent.timeout ? bus->parent.timeout : RT_TICK_PER_SECOND;
+
+    bus->msgs = msgs;
+    bus->num = num;
+    bus->idx = 0;
+    bus->result = 0;
+    bus->state = I2C_STATE_IDLE;
+    rt_completion_init(&bus->done);
+
+    SWM181_I2C_INT_CLR(I2Cx);
+    NVIC_DisableIRQ(bus->irqn);
+    I2C_INTEn(I2Cx);
+    swm181_i2c_next(bus);
+    NVIC_EnableIRQ(bus->irqn);
+
+    if (rt_completion_wait(&bus->done, timeout) != RT_EOK)
+    {
+        /* slave holding SCL or a lost interrupt: take the bus back by hand */
+        NVIC_DisableIRQ(bus->irqn);
+        I2C_INTDis(I2Cx);
+        swm181_i2c_recover(bus);
+        bus->state = I2C_STATE_IDLE;
+        SWM181_I2C_INT_CLR(I2Cx);
+        return -RT_ETIMEOUT;
+    }
+
+    I2C_INTDis(I2Cx);
+    return bus->result;
+}
+
+/* busy-waiting version for callers that cannot sleep, e.g. before the scheduler runs */
+static rt_ssize_t swm181_i2c_xfer_poll(struct swm181_i2c_bus *i2c_bus, struct rt_i2c_msg msgs[], rt_uint32_t num)
 {
-    struct swm181_i2c_bus *i2c_bus = (struct swm181_i2c_bus *)bus;
     I2C_TypeDef *I2Cx = i2c_bus->I2Cx;
     rt_uint32_t i;
 
@@ -91,21 +462,249 @@ static rt_ssize_t swm181_i2c_master_xfer(struct rt_i2c_bus_device *bus, struct r
     return num;
 }
 
+/* CLKDIV is 16 bits wide and only takes effect while the controller is disabled */
+static rt_bool_t swm181_i2c_clk_valid(rt_uint32_t hz)
+{
+    return hz >= 1000 && hz <= 1000000 && SystemCoreClock / 5 / hz - 1 <= 0xFFFF;
+}
+
+static void swm181_i2c_set_clk(struct swm181_i2c_bus *bus, rt_uint32_t hz)
+{
+    if (hz == bus->cur_clk)
+        return;
+
+    I2C_Close(bus->I2Cx);
+    bus->I2Cx->CLKDIV = SystemCoreClock / 5 / hz - 1;
+    I2C_Open(bus->I2Cx);
+    bus->cur_clk = hz;
+}
+
+static rt_uint32_t swm181_i2c_dev_clk_get(struct swm181_i2c_bus *bus, rt_uint16_t addr)
+{
+    int i;
+
+    for (i = 0; i < SWM181_I2C_DEV_CLK_MAX; i++)
+    {
+        if (bus->dev_clk[i].hz != 0 && bus->dev_clk[i].addr == addr)
+            return bus->dev_clk[i].hz;
+    }
+
+    return bus->clk;
+}
+
+static rt_err_t swm181_i2c_dev_clk_set(struct swm181_i2c_bus *bus, const struct swm181_i2c_dev_clk *cfg)
+{
+    struct swm181_i2c_dev_clk *slot = RT_NULL;
+    int i;
+
+    if (cfg->hz != 0 && !swm181_i2c_clk_valid(cfg->hz))
+        return -RT_EINVAL;
+
+    for (i = 0; i < SWM181_I2C_DEV_CLK_MAX; i++)
+    {
+        if (bus->dev_clk[i].hz != 0 && bus->dev_clk[i].addr == cfg->addr)
+        {
+            slot = &bus->dev_clk[i];
+            break;
+        }
+        if (bus->dev_clk[i].hz == 0 && slot == RT_NULL)
+            slot = &bus->dev_clk[i];
+    }
+
+    if (slot == RT_NULL)
+        return (cfg->hz == 0) ? RT_EOK : -RT_EFULL;
+
+    slot->addr = cfg->addr;
+    slot->hz = cfg->hz;
+
+    return RT_EOK;
+}
+
+static rt_ssize_t swm181_i2c_master_xfer(struct rt_i2c_bus_device *bus, struct rt_i2c_msg msgs[], rt_uint32_t num)
+{
+    struct swm181_i2c_bus *i2c_bus = (struct swm181_i2c_bus *)bus;
+
+    if (num == 0)
+        return 0;
+
+    /* the first message decides, a repeated start must not change the rate mid transfer */
+    swm181_i2c_set_clk(i2c_bus, swm181_i2c_dev_clk_get(i2c_bus, msgs[0].addr));
+
+    if (rt_interrupt_get_nest() == 0 && rt_thread_self() != RT_NULL)
+        return swm181_i2c_xfer_int(i2c_bus, msgs, num);
+
+    return swm181_i2c_xfer_poll(i2c_bus, msgs, num);
+}
+
+/* rates are applied by the next transfer, which runs with the bus lock held */
+static rt_err_t swm181_i2c_bus_control(struct rt_i2c_bus_device *bus, int cmd, void *args)
+{
+    struct swm181_i2c_bus *i2c_bus = (struct swm181_i2c_bus *)bus;
+    rt_err_t ret = RT_EOK;
+
+    if (args == RT_NULL)
+        return -RT_EINVAL;
+
+    rt_mutex_take(&bus->lock, RT_WAITING_FOREVER);
+    switch (cmd)
+    {
+    case RT_I2C_DEV_CTRL_CLK:
+        if (swm181_i2c_clk_valid(*(rt_uint32_t *)args))
+            i2c_bus->clk = *(rt_uint32_t *)args;
+        else
+            ret = -RT_EINVAL;
+        break;
+
+    case SWM181_I2C_CTRL_DEV_CLK:
+        ret = swm181_i2c_dev_clk_set(i2c_bus, (const struct swm181_i2c_dev_clk *)args);
+        break;
+
+    default:
+        ret = -RT_EINVAL;
+        break;
+    }
+    rt_mutex_release(&bus->lock);
+
+    return ret;
+}
+
 static const struct rt_i2c_bus_device_ops swm181_i2c_ops =
 {
     swm181_i2c_master_xfer,
     RT_NULL,
-    RT_NULL
+    swm181_i2c_bus_control
 };
 
-static struct swm181_i2c_bus i2c_objs[] = {
-#ifdef BSP_USING_I2C0
-    { .I2Cx = I2C0, .name = "i2c0", .scl_pin_name = BSP_I2C0_SCL_PIN, .sda_pin_name = BSP_I2C0_SDA_PIN },
+
+#ifdef SWM181_I2C_USING_SLAVE
+static rt_err_t swm181_i2c_slave_open(rt_device_t dev, rt_uint16_t oflag)
+{
+    struct swm181_i2c_slave *slave = (struct swm181_i2c_slave *)dev;
+    I2C_InitStructure init_struct;
+
+    init_struct.Master = 0;
+    init_struct.Addr7b = 1;
+    init_struct.MstClk = SWM181_I2C_DEFAULT_CLK;
+    init_struct.MstIEn = 0;
+    init_struct.SlvAddr = slave->addr;
+    init_struct.SlvAddrMask = 0xFF;     /* compare every address bit */
+    init_struct.SlvRxEndIEn = 1;
+    init_struct.SlvTxEndIEn = 1;
+    init_struct.SlvSTADetIEn = 0;
+    init_struct.SlvSTODetIEn = 0;
+    init_struct.SlvRdReqIEn = 1;
+    init_struct.SlvWrReqIEn = 1;
+
+    slave->ptr = 0;
+    slave->reg_phase = RT_FALSE;
+    I2C_Init(slave->bus->I2Cx, &init_struct);
+    I2C_Open(slave->bus->I2Cx);
+    NVIC_EnableIRQ(slave->bus->irqn);
+
+    return RT_EOK;
+}
+
+static rt_err_t swm181_i2c_slave_close(rt_device_t dev)
+{
+    struct swm181_i2c_slave *slave = (struct swm181_i2c_slave *)dev;
+
+    NVIC_DisableIRQ(slave->bus->irqn);
+    I2C_Close(slave->bus->I2Cx);
+
+    return RT_EOK;
+}
+
+/* pos is the register index; the SRAM image is accessed without running any callback */
+static rt_ssize_t swm181_i2c_slave_read(rt_device_t dev, rt_off_t pos, void *buffer, rt_size_t size)
+{
+    struct swm181_i2c_slave *slave = (struct swm181_i2c_slave *)dev;
+    rt_base_t level;
+
+    if (pos < 0 || pos >= slave->map.size)
+        return 0;
+    if (size > slave->map.size - pos)
+        size = slave->map.size - pos;
+
+    level = rt_hw_interrupt_disable();
+    rt_memcpy(buffer, &slave->map.regs[pos], size);
+    rt_hw_interrupt_enable(level);
+
+    return size;
+}
+
+static rt_ssize_t swm181_i2c_slave_write(rt_device_t dev, rt_off_t pos, const void *buffer, rt_size_t size)
+{
+    struct swm181_i2c_slave *slave = (struct swm181_i2c_slave *)dev;
+    rt_base_t level;
+
+    if (pos < 0 || pos >= slave->map.size)
+        return 0;
+    if (size > slave->map.size - pos)
+        size = slave->map.size - pos;
+
+    level = rt_hw_interrupt_disable();
+    rt_memcpy(&slave->map.regs[pos], buffer, size);
+    rt_hw_interrupt_enable(level);
+
+    return size;
+}
+
+static rt_err_t swm181_i2c_slave_control(rt_device_t dev, int cmd, void *args)
+{
+    struct swm181_i2c_slave *slave = (struct swm181_i2c_slave *)dev;
+    struct swm181_i2cs_map *map = (struct swm181_i2cs_map *)args;
+    rt_base_t level;
+
+    switch (cmd)
+    {
+    case SWM181_I2CS_CTRL_SET_MAP:
+        if (map == RT_NULL || map->size > 256 || (map->size != 0 && map->regs == RT_NULL))
+            return -RT_EINVAL;
+        level = rt_hw_interrupt_disable();
+        slave->map = *map;
+        slave->ptr = 0;
+        rt_hw_interrupt_enable(level);
+        break;
+
+    default:
+        return -RT_EINVAL;
+    }
+
+    return RT_EOK;
+}
+
+#ifdef RT_USING_DEVICE_OPS
+const static struct rt_device_ops swm181_i2c_slave_ops =
+{
+    RT_NULL,
+    swm181_i2c_slave_open,
+    swm181_i2c_slave_close,
+    swm181_i2c_slave_read,
+    swm181_i2c_slave_write,
+    swm181_i2c_slave_control
+};
 #endif
-#ifdef BSP_USING_I2C1
-    { .I2Cx = I2C1, .name = "i2c1", .scl_pin_name = BSP_I2C1_SCL_PIN, .sda_pin_name = BSP_I2C1_SDA_PIN },
+
+static rt_err_t swm181_i2c_slave_register(struct swm181_i2c_bus *bus)
+{
+    struct swm181_i2c_slave *slave = bus->slave;
+
+    slave->bus = bus;
+    slave->parent.type = RT_Device_Class_Miscellaneous;
+#ifdef RT_USING_DEVICE_OPS
+    slave->parent.ops = &swm181_i2c_slave_ops;
+#else
+    slave->parent.init = RT_NULL;
+    slave->parent.open = swm181_i2c_slave_open;
+    slave->parent.close = swm181_i2c_slave_close;
+    slave->parent.read = swm181_i2c_slave_read;
+    slave->parent.write = swm181_i2c_slave_write;
+    slave->parent.control = swm181_i2c_slave_control;
 #endif
-};
+
+    return rt_device_register(&slave->parent, slave->name, RT_DEVICE_FLAG_RDWR);
+}
+#endif /* SWM181_I2C_USING_SLAVE */
 
 int rt_hw_i2c_init(void)
 {
@@ -114,7 +713,7 @@ int rt_hw_i2c_init(void)
 
     init_struct.Master = 1;
     init_struct.Addr7b = 1;
-    init_struct.MstClk = 100000;
+    init_struct.MstClk = SWM181_I2C_DEFAULT_CLK;
     init_struct.MstIEn = 0;
     init_struct.SlvAddr = 0;
     init_struct.SlvAddrMask = 0;
@@ -143,10 +742,27 @@ int rt_hw_i2c_init(void)
 
         PORT_Init(SWM181_PIN_GET_PORT_PTR(scl_pin), SWM181_PIN_GET_PIN_IDX(scl_pin), scl_func, 1);
         PORT_Init(SWM181_PIN_GET_PORT_PTR(sda_pin), SWM181_PIN_GET_PIN_IDX(sda_pin), sda_func, 1);
+        bus->scl_pin = scl_pin;
+        bus->sda_pin = sda_pin;
+
+#ifdef SWM181_I2C_USING_SLAVE
+        if (bus->slave != RT_NULL)
+        {
+            /* enabled again by open */
+            IRQ_Connect(bus->periph_irq, bus->irqn, 2);
+            NVIC_DisableIRQ(bus->irqn);
+            swm181_i2c_slave_register(bus);
+            continue;
+        }
+#endif
 
         bus->parent.ops = &swm181_i2c_ops;
+        bus->clk = SWM181_I2C_DEFAULT_CLK;
+        bus->cur_clk = SWM181_I2C_DEFAULT_CLK;
         I2C_Init(bus->I2Cx, &init_struct);
         I2C_Open(bus->I2Cx);
+        rt_completion_init(&bus->done);
+        IRQ_Connect(bus->periph_irq, bus->irqn, 2);
         rt_i2c_bus_device_register(&bus->parent, bus->name);
     }
 
@@ -10,6 +10,44 @@
 #ifndef DRV_I2C_H__
 #define DRV_I2C_H__
 
+#include <rtthread.h>
+
+/* rt_i2c_control() command: SCL rate for one slave address, arg: struct swm181_i2c_dev_clk *.
+ * RT_I2C_DEV_CTRL_CLK sets the rate of every other slave on the bus. */
+#define SWM181_I2C_CTRL_DEV_CLK     (RT_DEVICE_CTRL_BASE(I2CBUS) + 0x20)
+
+struct swm181_i2c_dev_clk
+{
+    rt_uint16_t addr;           /* 7-bit slave address */
+    rt_uint32_t hz;             /* 0 drops the entry, the slave falls back to the bus rate */
+};
+
+/* rt_device_control() command of the slave devices "i2cs0" / "i2cs1", arg: struct swm181_i2cs_map * */
+#define SWM181_I2CS_CTRL_SET_MAP    (RT_DEVICE_CTRL_BASE(Char) + 0x38)
+
+#define SWM181_I2CS_REG_RO          0x01    /* host writes are acknowledged and dropped */
+
+/* Callbacks run in the I2C interrupt and must not block. read() returns the byte sent to the
+ * host, val is the SRAM copy; it may be called for one register past the last byte the host
+ * actually reads, because the next byte is loaded before the host ACKs or NACKs. write() runs
+ * after val was stored. */
+struct swm181_i2cs_reg
+{
+    rt_uint8_t flags;           /* SWM181_I2CS_REG_xxx */
+    rt_uint8_t (*read)(rt_uint8_t reg, rt_uint8_t val, void *arg);
+    void (*write)(rt_uint8_t reg, rt_uint8_t val, void *arg);
+};
+
+/* The host writes a register index, then data that auto-increments from it. A read starts at
+ * the last index written or where the previous access stopped. */
+struct swm181_i2cs_map
+{
+    rt_uint8_t *regs;           /* SRAM image, owned by the caller, host register n is regs[n] */
+    rt_uint16_t size;           /* 1..256 */
+    const struct swm181_i2cs_reg *reg;  /* size entries, or RT_NULL for plain memory */
+    void *arg;
+};
+
 int rt_hw_i2c_init(void);
 
 #endif
@@ -0,0 +1,164 @@
+/*
+ * Copyright (c) 2006-2022, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ */
+
+#include <rtthread.h>
+#include <rtdevice.h>
+#include <board.h>
+#include "drv_i2c_poll.h"
+
+#ifdef BSP_USING_I2C_POLL
+
+static struct i2c_poll_table *poll_table;
+static struct rt_i2c_bus_device *poll_bus;
+
+/* write the register index, then read len bytes after a repeated start */
+static rt_err_t i2c_poll_run(struct i2c_poll_job *job, rt_uint8_t *buf)
+{
+    struct rt_i2c_msg msgs[2];
+
+    msgs[0].addr = job->addr;
+    msgs[0].flags = RT_I2C_WR | RT_I2C_NO_STOP;
+    msgs[0].buf = &job->reg;
+    msgs[0].len = 1;
+    msgs[1].addr = job->addr;
+    msgs[1].flags = RT_I2C_RD;
+    msgs[1].buf = buf;
+    msgs[1].len = job->len;
+
+    return rt_i2c_transfer(poll_bus, msgs, 2) == 2 ? RT_EOK : -RT_EIO;
+}
+
+/* Fill the slot readers are not looking at, then flip to it. Right after the flip the worker
+ * may start on the slot a slow reader is still copying, so a reader that sees seq move at
+ * all while copying starts over. */
+static void i2c_poll_publish(struct i2c_poll_job *job)
+{
+    __DMB();
+    job->seq++;
+}
+
+static void i2c_poll_entry(void *parameter)
+{
+    struct i2c_poll_table *table = (struct i2c_poll_table *)parameter;
+    rt_tick_t now, wait;
+    rt_int32_t left;
+    int i;
+
+    now = rt_tick_get();
+    for (i = 0; i < table->count; i++)
+        table->jobs[i].next = now;
+
+    while (1)
+    {
+        /* everything that is due runs back to back under one hold of the bus */
+        rt_mutex_take(&poll_bus->lock, RT_WAITING_FOREVER);
+        for (i = 0; i < table->count; i++)
+        {
+            struct i2c_poll_job *job = &table->jobs[i];
+            struct i2c_poll_slot *slot = &job->slot[(job->seq + 1) & 1];
+
+            now = rt_tick_get();
+            if ((rt_int32_t)(now - job->next) < 0)
+                continue;
+
+            if (i2c_poll_run(job, slot->data) == RT_EOK)
+            {
+                slot->stamp = rt_tick_get();
+                i2c_poll_publish(job);
+            }
+            else
+            {
+                job->errors++;
+            }
+
+            job->next += rt_tick_from_millisecond(job->period);
+            /* fell behind by more than a period: skip the missed reads instead of bursting */
+            if ((rt_int32_t)(now - job->next) >= 0)
+                job->next = now + rt_tick_from_millisecond(job->period);
+        }
+        rt_mutex_release(&poll_bus->lock);
+
+        now = rt_tick_get();
+        wait = RT_TICK_MAX;
+        for (i = 0; i < table->count; i++)
+        {
+            left = (rt_int32_t)(table->jobs[i].next - now);
+            if (left <= 0)
+            {
+                wait = 0;
+                break;
+            }
+            if ((rt_tick_t)left < wait)
+                wait = left;
+        }
+
+        if (wait != 0)
+            rt_thread_delay(wait);
+    }
+}
+
+rt_err_t i2c_poll_start(struct i2c_poll_table *table)
+{
+    rt_thread_t tid;
+    int i;
+
+    if (table == RT_NULL || table->jobs == RT_NULL || table->count == 0)
+        return -RT_EINVAL;
+    if (poll_table != RT_NULL)
+        return -RT_EBUSY;
+
+    for (i = 0; i < table->count; i++)
+    {
+        struct i2c_poll_job *job = &table->jobs[i];
+
+        if (job->len == 0 || job->len > BSP_I2C_POLL_MAX_LEN || job->period == 0)
+            return -RT_EINVAL;
+        job->seq = 0;
+        job->errors = 0;
+    }
+
+    poll_bus = rt_i2c_bus_device_find(table->bus_name);
+    if (poll_bus == RT_NULL)
+        return -RT_ENOSYS;
+
+    tid = rt_thread_create("i2cpoll", i2c_poll_entry, table, BSP_I2C_POLL_STACK_SIZE,
+                           BSP_I2C_POLL_PRIORITY, 10);
+    if (tid == RT_NULL)
+        return -RT_ENOMEM;
+
+    poll_table = table;
+    rt_thread_startup(tid);
+
+    return RT_EOK;
+}
+
+/* Copies the latest result into buf (job->len bytes) without taking any lock. Returns
+ * -RT_EEMPTY until the first read succeeded. Callable from interrupts as well. */
+rt_err_t i2c_poll_read(struct i2c_poll_job *job, void *buf, rt_tick_t *stamp)
+{
+    rt_uint32_t seq;
+    struct i2c_poll_slot *slot;
+
+    do
+    {
+        seq = job->seq;
+        if (seq == 0)
+            return -RT_EEMPTY;
+        __DMB();
+        slot = &job->slot[seq & 1];
+        rt_memcpy(buf, slot->data, job->len);
+        if (stamp != RT_NULL)
+            *stamp = slot->stamp;
+        __DMB();
+    } while (job->seq != seq);
+
+    return RT_EOK;
+}
+
+#endif /* BSP_USING_I2C_POLL */
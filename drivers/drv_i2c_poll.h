@@ -0,0 +1,46 @@
+/*
+ * Copyright (c) 2006-2022, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ */
+
+#ifndef DRV_I2C_POLL_H__
+#define DRV_I2C_POLL_H__
+
+#include <rtthread.h>
+
+struct i2c_poll_slot
+{
+    rt_tick_t stamp;            /* tick the read completed */
+    rt_uint8_t data[BSP_I2C_POLL_MAX_LEN];
+};
+
+/* One periodic register read. Only addr..period are filled in by the caller. */
+struct i2c_poll_job
+{
+    rt_uint16_t addr;           /* 7-bit slave address */
+    rt_uint8_t reg;             /* first register, written before the repeated-start read */
+    rt_uint8_t len;             /* 1..BSP_I2C_POLL_MAX_LEN */
+    rt_uint32_t period;         /* ms */
+
+    /* owned by the worker */
+    rt_tick_t next;
+    rt_uint32_t errors;         /* failed transfers, the last good result stays published */
+    volatile rt_uint32_t seq;   /* results published so far, slot[seq & 1] is the latest */
+    struct i2c_poll_slot slot[2];
+};
+
+struct i2c_poll_table
+{
+    const char *bus_name;
+    struct i2c_poll_job *jobs;  /* owned by the caller, must stay valid while polling */
+    rt_uint8_t count;
+};
+
+rt_err_t i2c_poll_start(struct i2c_poll_table *table);
+rt_err_t i2c_poll_read(struct i2c_poll_job *job, void *buf, rt_tick_t *stamp);
+
+#endif
@@ -0,0 +1,694 @@
+/*
+ * Copyright (c) 2006-2022, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ */
+
+#include <rthw.h>
+#include <rtthread.h>
+#include <rtdevice.h>
+#include <board.h>
+#include "drv_can.h"
+#include "drv_isotp.h"
+
+#ifdef BSP_USING_ISOTP
+
+#if defined(BSP_ISOTP_USING_TIMR0)
+#ifdef BSP_USING_HWTIMER0
+#error "TIMR0 is used by both timer0 and ISO-TP"
+#endif
+#define ISOTP_TIMR              TIMR0
+#define ISOTP_TIMR_PERIPH_IRQ   IRQ0_15_TIMR0
+#define ISOTP_TIMR_IRQn         IRQ5_IRQ
+#define ISOTP_TIMR_IRQHandler   IRQ5_Handler
+#elif defined(BSP_ISOTP_USING_TIMR1)
+#ifdef BSP_USING_HWTIMER1
+#error "TIMR1 is used by both timer1 and ISO-TP"
+#endif
+#define ISOTP_TIMR              TIMR1
+#define ISOTP_TIMR_PERIPH_IRQ   IRQ0_15_TIMR1
+#define ISOTP_TIMR_IRQn         IRQ6_IRQ
+#define ISOTP_TIMR_IRQHandler   IRQ6_Handler
+#elif defined(BSP_ISOTP_USING_TIMR2)
+#ifdef BSP_USING_HWTIMER2
+#error "TIMR2 is used by both timer2 and ISO-TP"
+#endif
+#define ISOTP_TIMR              TIMR2
+#define ISOTP_TIMR_PERIPH_IRQ   IRQ0_15_TIMR2
+#define ISOTP_TIMR_IRQn         IRQ7_IRQ
+#define ISOTP_TIMR_IRQHandler   IRQ7_Handler
+#else
+#ifdef BSP_USING_HWTIMER3
+#error "TIMR3 is used by both timer3 and ISO-TP"
+#endif
+#define ISOTP_TIMR              TIMR3
+#define ISOTP_TIMR_PERIPH_IRQ   IRQ0_15_TIMR3
+#define ISOTP_TIMR_IRQn         IRQ8_IRQ
+#define ISOTP_TIMR_IRQHandler   IRQ8_Handler
+#endif
+
+#define ISOTP_CAN_NAME          "can1"
+#define ISOTP_PAD_BYTE          0xCC
+
+/* protocol control information, high nibble of the first data byte */
+#define ISOTP_PCI_SF            0x0
+#define ISOTP_PCI_FF            0x1
+#define ISOTP_PCI_CF            0x2
+#define ISOTP_PCI_FC            0x3
+
+#define ISOTP_FS_CTS            0
+#define ISOTP_FS_WAIT           1
+#define ISOTP_FS_OVFLW          2
+
+/* swm181_can_send() tags, tell the completions apart */
+#define ISOTP_TAG_SF            0
+#define ISOTP_TAG_FF            1
+#define ISOTP_TAG_CF            2
+#define ISOTP_TAG_FC            3
+
+#define ISOTP_TX_IDLE           0
+#define ISOTP_TX_SF             1   /* single frame on its way */
+#define ISOTP_TX_FF             2   /* first frame on its way */
+#define ISOTP_TX_WAIT_FC        3
+#define ISOTP_TX_CF             4   /* consecutive frame on its way or STmin running */
+
+#define ISOTP_RX_IDLE           0
+#define ISOTP_RX_BUSY           1
+
+static struct isotp_link *isotp_cur;
+static rt_device_t isotp_can;
+
+static rt_uint32_t isotp_stmin_cycles(rt_uint8_t stmin)
+{
+    rt_uint32_t us;
+
+    if (stmin <= 0x7F)
+        us = stmin * 1000;
+    else if (stmin >= 0xF1 && stmin <= 0xF9)
+        us = (stmin - 0xF0) * 100;
+    else
+        us = 0x7F * 1000;       /* reserved values mean the longest gap */
+
+    return us * (SystemCoreClock / 1000000);
+}
+
+/* one-shot, the next consecutive frame goes out from the timer interrupt */
+static void isotp_pace(rt_uint32_t cycles)
+{
+    TIMR_Stop(ISOTP_TIMR);
+    TIMR_SetPeriod(ISOTP_TIMR, cycles);
+    TIMR_INTClr(ISOTP_TIMR);
+    TIMR_Start(ISOTP_TIMR);
+}
+
+static rt_err_t isotp_frame_send(struct isotp_link *link, struct rt_can_msg *msg, rt_uint8_t len, rt_uint32_t tag)
+{
+    msg->id = link->tx_id;
+    msg->ide = link->ide;
+    msg->rtr = RT_CAN_DTR;
+#ifdef BSP_ISOTP_PADDING
+    rt_memset(&msg->data[len], ISOTP_PAD_BYTE, 8 - len);
+    len = 8;
+#endif
+    msg->len = len;
+
+    return swm181_can_send(msg, tag);
+}
+
+static void isotp_tx_finish(struct isotp_link *link, rt_err_t result)
+{
+    TIMR_Stop(ISOTP_TIMR);
+    rt_timer_stop(&link->tx_timer);
+    link->tx_state = ISOTP_TX_IDLE;
+    link->tx_result = result;
+    if (result == RT_EOK)
+        link->stats.tx_msgs++;
+    rt_completion_done(&link->tx_done);
+}
+
+static void isotp_rx_finish(struct isotp_link *link, rt_err_t result)
+{
+    rt_timer_stop(&link->rx_timer);
+    link->rx_state = ISOTP_RX_IDLE;
+    link->rx_result = result;
+    link->rx_buf = RT_NULL;
+    link->rx_ready = RT_TRUE;
+    if (result == RT_EOK)
+        link->stats.rx_msgs++;
+    else
+        link->stats.rx_aborted++;
+    rt_completion_done(&link->rx_done);
+}
+
+static void isotp_cf_send(struct isotp_link *link)
+{
+    struct rt_can_msg msg;
+    rt_uint16_t n = link->tx_len - link->tx_pos;
+    rt_err_t ret;
+
+    if (n > 7)
+        n = 7;
+    msg.data[0] = (ISOTP_PCI_CF << 4) | link->tx_sn;
+    rt_memcpy(&msg.data[1], link->tx_buf + link->tx_pos, n);
+
+    ret = isotp_frame_send(link, &msg, 1 + n, ISOTP_TAG_CF);
+    if (ret == RT_EOK)
+    {
+        link->tx_pos += n;
+        link->tx_sn = (link->tx_sn + 1) & 0x0F;
+    }
+    else if (ret == -RT_EBUSY)
+    {
+        /* other writers filled the TX queue, try again in about a frame time */
+        isotp_pace(isotp_stmin_cycles(0xF1));
+    }
+    else
+    {
+        isotp_tx_finish(link, ret);
+    }
+}
+
+static rt_err_t isotp_fc_send(struct isotp_link *link, rt_uint8_t fs)
+{
+    struct rt_can_msg msg;
+
+    msg.data[0] = (ISOTP_PCI_FC << 4) | fs;
+    msg.data[1] = link->block_size;
+    msg.data[2] = link->stmin;
+
+    return isotp_frame_send(link, &msg, 3, ISOTP_TAG_FC);
+}
+
+static void isotp_rx_single(struct isotp_link *link, const struct rt_can_msg *msg)
+{
+    rt_uint8_t len = msg->data[0] & 0x0F;
+
+    if (len == 0 || len > msg->len - 1)
+        return;
+
+    /* a single frame ends a segmented reception, that message is lost */
+    if (link->rx_state == ISOTP_RX_BUSY)
+    {
+        link->rx_state = ISOTP_RX_IDLE;
+        link->stats.rx_aborted++;
+    }
+    if (link->rx_buf == RT_NULL || link->rx_size < len)
+    {
+        link->stats.rx_no_buf++;
+        return;
+    }
+
+    rt_memcpy(link->rx_buf, &msg->data[1], len);
+    link->rx_len = len;
+    isotp_rx_finish(link, RT_EOK);
+}
+
+static void isotp_rx_first(struct isotp_link *link, const struct rt_can_msg *msg)
+{
+    rt_uint16_t len = ((rt_uint16_t)(msg->data[0] & 0x0F) << 8) | msg->data[1];
+
+    if (msg->len < 8 || len < 8)
+        return;
+
+    /* a new first frame restarts the reception in the same buffer */
+    if (link->rx_state == ISOTP_RX_BUSY)
+    {
+        link->rx_state = ISOTP_RX_IDLE;
+        link->stats.rx_aborted++;
+    }
+    if (link->rx_buf == RT_NULL || link->rx_size < len)
+    {
+        link->stats.rx_no_buf++;
+        isotp_fc_send(link, ISOTP_FS_OVFLW);
+        return;
+    }
+
+    rt_memcpy(link->rx_buf, &msg->data[2], 6);
+    link->rx_len = len;
+    link->rx_pos = 6;
+    link->rx_sn = 1;
+    link->rx_blk = 0;
+    link->rx_state = ISOTP_RX_BUSY;
+    if (isotp_fc_send(link, ISOTP_FS_CTS) != RT_EOK)
+    {
+        isotp_rx_finish(link, -RT_EIO);
+        return;
+    }
+    rt_timer_start(&link->rx_timer);
+}
+
+static void isotp_rx_consecutive(struct isotp_link *link, const struct rt_can_msg *msg)
+{
+    rt_uint16_t n = link->rx_len - link->rx_pos;
+
+    if (link->rx_state != ISOTP_RX_BUSY)
+        return;
+
+    if (n > 7)
+        n = 7;
+    if ((msg->data[0] & 0x0F) != link->rx_sn || msg->len - 1 < n)
+    {
+        isotp_rx_finish(link, -RT_ERROR);
+        return;
+    }
+
+    rt_memcpy(link->rx_buf + link->rx_pos, &msg->data[1], n);
+    link->rx_pos += n;
+    link->rx_sn = (link->rx_sn + 1) & 0x0F;
+    if (link->rx_pos == link->rx_len)
+    {
+        isotp_rx_finish(link, RT_EOK);
+        return;
+    }
+
+    if (link->block_size != 0 && ++link->rx_blk == link->block_size)
+    {
+        link->rx_blk = 0;
+        if (isotp_fc_send(link, ISOTP_FS_CTS) != RT_EOK)
+        {
+            isotp_rx_finish(link, -RT_EIO);
+            return;
+        }
+    }
+    rt_timer_start(&link->rx_timer);
+}
+
+/* The peer's answer to our first frame or block. Accepted while the first frame is still
+ * reported as on its way too: in loopback its echo is handled before its TX interrupt. */
+static void isotp_rx_flow(struct isotp_link *link, const struct rt_can_msg *msg)
+{
+    if ((link->tx_state != ISOTP_TX_FF && link->tx_state != ISOTP_TX_WAIT_FC) || msg->len < 3)
+        return;
+
+    switch (msg->data[0] & 0x0F)
+    {
+    case ISOTP_FS_CTS:
+        rt_timer_stop(&link->tx_timer);
+        link->tx_bs = msg->data[1];
+        link->tx_gap = isotp_stmin_cycles(msg->data[2]);
+        link->tx_blk = 0;
+        link->tx_state = ISOTP_TX_CF;
+        isotp_cf_send(link);
+        break;
+    case ISOTP_FS_WAIT:
+        link->stats.fc_wait++;
+        rt_timer_start(&link->tx_timer);
+        break;
+    case ISOTP_FS_OVFLW:
+        isotp_tx_finish(link, -RT_EFULL);
+        break;
+    default:
+        isotp_tx_finish(link, -RT_ERROR);
+        break;
+    }
+}
+
+/* CAN interrupt: every frame that passed the filters */
+static rt_bool_t isotp_rx_hook(void *arg, const struct rt_can_msg *msg)
+{
+    struct isotp_link *link = (struct isotp_link *)arg;
+
+    if (msg->id != link->rx_id || msg->ide != link->ide || msg->rtr != RT_CAN_DTR || msg->len == 0)
+        return RT_FALSE;
+
+    switch (msg->data[0] >> 4)
+    {
+    case ISOTP_PCI_SF:
+        isotp_rx_single(link, msg);
+        break;
+    case ISOTP_PCI_FF:
+        isotp_rx_first(link, msg);
+        break;
+    case ISOTP_PCI_CF:
+        isotp_rx_consecutive(link, msg);
+        break;
+    case ISOTP_PCI_FC:
+        isotp_rx_flow(link, msg);
+        break;
+    }
+
+    return RT_TRUE;
+}
+
+/* CAN interrupt: one of our frames left the controller or was given up */
+static void isotp_tx_hook(void *arg, rt_uint32_t tag, rt_err_t result)
+{
+    struct isotp_link *link = (struct isotp_link *)arg;
+
+    switch (tag)
+    {
+    case ISOTP_TAG_FC:
+        if (result != RT_EOK && link->rx_state == ISOTP_RX_BUSY)
+            isotp_rx_finish(link, result);
+        break;
+    case ISOTP_TAG_SF:
+        if (link->tx_state == ISOTP_TX_SF)
+            isotp_tx_finish(link, result);
+        break;
+    case ISOTP_TAG_FF:
+        if (link->tx_state != ISOTP_TX_FF)
+            break;
+        if (result != RT_EOK)
+        {
+            isotp_tx_finish(link, result);
+            break;
+        }
+        link->tx_state = ISOTP_TX_WAIT_FC;
+        rt_timer_start(&link->tx_timer);
+        break;
+    case ISOTP_TAG_CF:
+        if (link->tx_state != ISOTP_TX_CF)
+            break;
+        if (result != RT_EOK || link->tx_pos == link->tx_len)
+        {
+            isotp_tx_finish(link, result);
+        }
+        else if (link->tx_bs != 0 && ++link->tx_blk == link->tx_bs)
+        {
+            link->tx_state = ISOTP_TX_WAIT_FC;
+            rt_timer_start(&link->tx_timer);
+        }
+        else if (link->tx_gap == 0)
+        {
+            isotp_cf_send(link);
+        }
+        else
+        {
+            isotp_pace(link->tx_gap);
+        }
+        break;
+    }
+}
+
+void ISOTP_TIMR_IRQHandler(void)
+{
+    rt_interrupt_enter();
+    TIMR_Stop(ISOTP_TIMR);
+    TIMR_INTClr(ISOTP_TIMR);
+    if (isotp_cur != RT_NULL && isotp_cur->tx_state == ISOTP_TX_CF)
+        isotp_cf_send(isotp_cur);
+    rt_interrupt_leave();
+}
+
+/* N_Bs: no flow control from the peer */
+static void isotp_tx_timeout(void *parameter)
+{
+    struct isotp_link *link = (struct isotp_link *)parameter;
+
+    if (link->tx_state == ISOTP_TX_WAIT_FC)
+        isotp_tx_finish(link, -RT_ETIMEOUT);
+}
+
+/* N_Cr: the peer stopped in the middle of a message */
+static void isotp_rx_timeout(void *parameter)
+{
+    struct isotp_link *link = (struct isotp_link *)parameter;
+
+    if (link->rx_state == ISOTP_RX_BUSY)
+        isotp_rx_finish(link, -RT_ETIMEOUT);
+}
+
+/* Runs the link in the CAN and timer interrupts, the caller's thread only wakes up once per
+ * message. can1 is opened and keeps its baud rate and mode. */
+rt_err_t isotp_open(struct isotp_link *link)
+{
+    struct swm181_can_hook hook;
+    rt_device_t dev;
+    rt_tick_t tick;
+    rt_err_t ret;
+
+    if (link == RT_NULL || (link->ide != RT_CAN_STDID && link->ide != RT_CAN_EXTID))
+        return -RT_EINVAL;
+    if (isotp_cur != RT_NULL)
+        return -RT_EBUSY;
+
+    dev = rt_device_find(ISOTP_CAN_NAME);
+    if (dev == RT_NULL)
+        return -RT_ENOSYS;
+    ret = rt_device_open(dev, RT_DEVICE_FLAG_INT_TX | RT_DEVICE_FLAG_INT_RX);
+    if (ret != RT_EOK)
+        return ret;
+
+    link->tx_state = ISOTP_TX_IDLE;
+    link->rx_state = ISOTP_RX_IDLE;
+    link->rx_ready = RT_FALSE;
+    link->rx_buf = RT_NULL;
+    rt_memset(&link->stats, 0, sizeof(link->stats));
+    rt_completion_init(&link->tx_done);
+    rt_completion_init(&link->rx_done);
+
+    tick = rt_tick_from_millisecond(BSP_ISOTP_TIMEOUT_MS);
+    rt_timer_init(&link->tx_timer, "isotx", isotp_tx_timeout, link, tick,
+                  RT_TIMER_FLAG_ONE_SHOT | RT_TIMER_FLAG_HARD_TIMER);
+    rt_timer_init(&link->rx_timer, "isorx", isotp_rx_timeout, link, tick,
+                  RT_TIMER_FLAG_ONE_SHOT | RT_TIMER_FLAG_HARD_TIMER);
+
+    /* same priority as the CAN interrupt, so the two never preempt each other */
+    TIMR_Init(ISOTP_TIMR, TIMR_MODE_TIMER, SystemCoreClock / 1000, 1);
+    IRQ_Connect(ISOTP_TIMR_PERIPH_IRQ, ISOTP_TIMR_IRQn, 1);
+    NVIC_EnableIRQ(ISOTP_TIMR_IRQn);
+
+    isotp_can = dev;
+    isotp_cur = link;
+    hook.rx = isotp_rx_hook;
+    hook.tx_done = isotp_tx_hook;
+    hook.arg = link;
+    swm181_can_hook_set(&hook);
+
+    return RT_EOK;
+}
+
+/* no isotp_send() / isotp_recv() may be waiting */
+void isotp_close(struct isotp_link *link)
+{
+    if (link == RT_NULL || link != isotp_cur)
+        return;
+
+    swm181_can_hook_set(RT_NULL);
+    TIMR_Stop(ISOTP_TIMR);
+    NVIC_DisableIRQ(ISOTP_TIMR_IRQn);
+    rt_timer_detach(&link->tx_timer);
+    rt_timer_detach(&link->rx_timer);
+    isotp_cur = RT_NULL;
+
+    rt_device_close(isotp_can);
+    isotp_can = RT_NULL;
+}
+
+/* Blocks until the peer has all of data or the transfer failed. data is read by the
+ * interrupts while the message is on its way, it is never copied as a whole. */
+rt_err_t isotp_send(struct isotp_link *link, const void *data, rt_size_t len, rt_int32_t timeout)
+{
+    struct rt_can_msg msg;
+    rt_base_t level;
+    rt_err_t ret;
+
+    if (link != isotp_cur || data == RT_NULL || len == 0 || len > ISOTP_MAX_LEN)
+        return -RT_EINVAL;
+
+    level = rt_hw_interrupt_disable();
+    if (link->tx_state != ISOTP_TX_IDLE)
+    {
+        rt_hw_interrupt_enable(level);
+        return -RT_EBUSY;
+    }
+
+    link->tx_buf = (const rt_uint8_t *)data;
+    link->tx_len = len;
+    rt_completion_init(&link->tx_done);
+    if (len <= 7)
+    {
+        msg.data[0] = (ISOTP_PCI_SF << 4) | len;
+        rt_memcpy(&msg.data[1], data, len);
+        link->tx_state = ISOTP_TX_SF;
+        ret = isotp_frame_send(link, &msg, 1 + len, ISOTP_TAG_SF);
+    }
+    else
+    {
+        msg.data[0] = (ISOTP_PCI_FF << 4) | (len >> 8);
+        msg.data[1] = len & 0xFF;
+        rt_memcpy(&msg.data[2], data, 6);
+        link->tx_pos = 6;
+        link->tx_sn = 1;
+        link->tx_state = ISOTP_TX_FF;
+        ret = isotp_frame_send(link, &msg, 8, ISOTP_TAG_FF);
+    }
+    if (ret != RT_EOK)
+        link->tx_state = ISOTP_TX_IDLE;
+    rt_hw_interrupt_enable(level);
+
+    if (ret != RT_EOK)
+        return ret;
+
+    if (rt_completion_wait(&link->tx_done, timeout) != RT_EOK)
+    {
+        level = rt_hw_interrupt_disable();
+        if (link->tx_state != ISOTP_TX_IDLE)
+        {
+            /* frames already queued carry their own copy of the data */
+            TIMR_Stop(ISOTP_TIMR);
+            rt_timer_stop(&link->tx_timer);
+            link->tx_state = ISOTP_TX_IDLE;
+            rt_hw_interrupt_enable(level);
+            return -RT_ETIMEOUT;
+        }
+        rt_hw_interrupt_enable(level);
+    }
+
+    return link->tx_result;
+}
+
+/* Hands buf to the interrupts for the next message, e.g. before sending a request. The
+ * message is then collected with isotp_recv() on the same buffer. */
+rt_err_t isotp_recv_post(struct isotp_link *link, void *buf, rt_size_t size)
+{
+    rt_base_t level;
+    rt_err_t ret = RT_EOK;
+
+    if (link != isotp_cur || buf == RT_NULL || size == 0)
+        return -RT_EINVAL;
+
+    level = rt_hw_interrupt_disable();
+    if (link->rx_buf != RT_NULL || link->rx_ready)
+    {
+        ret = -RT_EBUSY;
+    }
+    else
+    {
+        link->rx_buf = (rt_uint8_t *)buf;
+        link->rx_size = size;
+        rt_completion_init(&link->rx_done);
+    }
+    rt_hw_interrupt_enable(level);
+
+    return ret;
+}
+
+/* Waits for the next message, reassembled in place in buf. Returns its length or an error;
+ * on timeout the buffer is taken back from the interrupts, a reception in progress is lost. */
+rt_ssize_t isotp_recv(struct isotp_link *link, void *buf, rt_size_t size, rt_int32_t timeout)
+{
+    rt_base_t level;
+    rt_ssize_t ret;
+
+    if (link != isotp_cur || buf == RT_NULL || size == 0)
+        return -RT_EINVAL;
+
+    level = rt_hw_interrupt_disable();
+    if (!link->rx_ready)
+    {
+        if (link->rx_buf == RT_NULL)
+        {
+            link->rx_buf = (rt_uint8_t *)buf;
+            link->rx_size = size;
+            rt_completion_init(&link->rx_done);
+        }
+        else if (link->rx_buf != buf)
+        {
+            rt_hw_interrupt_enable(level);
+            return -RT_EBUSY;
+        }
+    }
+    rt_hw_interrupt_enable(level);
+
+    if (rt_completion_wait(&link->rx_done, timeout) != RT_EOK)
+    {
+        level = rt_hw_interrupt_disable();
+        if (!link->rx_ready)
+        {
+            rt_timer_stop(&link->rx_timer);
+            link->rx_state = ISOTP_RX_IDLE;
+            link->rx_buf = RT_NULL;
+            rt_hw_interrupt_enable(level);
+            return -RT_ETIMEOUT;
+        }
+        rt_hw_interrupt_enable(level);
+    }
+
+    level = rt_hw_interrupt_disable();
+    link->rx_ready = RT_FALSE;
+    ret = (link->rx_result == RT_EOK) ? (rt_ssize_t)link->rx_len : link->rx_result;
+    rt_hw_interrupt_enable(level);
+
+    return ret;
+}
+
+#if defined(RT_USING_FINSH) && defined(RT_USING_HEAP)
+#include <stdlib.h>
+
+/* sends a message to itself with can1 in loopback mode, then puts the mode back */
+static int isotp_loop(int argc, char **argv)
+{
+    struct isotp_link link;
+    struct rt_can_device *can;
+    rt_uint8_t *tx, *rx;
+    rt_uint32_t mode;
+    rt_size_t len = argc > 1 ? atoi(argv[1]) : ISOTP_MAX_LEN;
+    rt_tick_t start;
+    rt_ssize_t got;
+    rt_err_t ret;
+    rt_size_t i;
+
+    if (argc > 4 || len == 0 || len > ISOTP_MAX_LEN)
+    {
+        rt_kprintf("Usage: isotp_loop [len] [block_size] [stmin]\n");
+        return -RT_EINVAL;
+    }
+
+    rt_memset(&link, 0, sizeof(link));
+    link.tx_id = 0x7E0;
+    link.rx_id = 0x7E0;
+    link.ide = RT_CAN_STDID;
+    link.block_size = argc > 2 ? atoi(argv[2]) : 0;
+    link.stmin = argc > 3 ? strtoul(argv[3], RT_NULL, 0) : 0;
+
+    tx = rt_malloc(len);
+    rx = rt_malloc(len);
+    if (tx == RT_NULL || rx == RT_NULL)
+    {
+        rt_free(tx);
+        rt_free(rx);
+        return -RT_ENOMEM;
+    }
+    for (i = 0; i < len; i++)
+        tx[i] = i * 7 + (i >> 8);
+
+    ret = isotp_open(&link);
+    if (ret != RT_EOK)
+    {
+        rt_kprintf("isotp_open failed: %d\n", (int)ret);
+        rt_free(tx);
+        rt_free(rx);
+        return ret;
+    }
+    can = (struct rt_can_device *)isotp_can;
+    mode = can->config.mode;
+    rt_device_control(isotp_can, RT_CAN_CMD_SET_MODE, (void *)RT_CAN_MODE_LOOPBACK);
+
+    isotp_recv_post(&link, rx, len);
+    start = rt_tick_get();
+    ret = isotp_send(&link, tx, len, RT_TICK_PER_SECOND * 5);
+    got = isotp_recv(&link, rx, len, RT_TICK_PER_SECOND);
+    start = rt_tick_get() - start;
+
+    if (ret != RT_EOK)
+        rt_kprintf("send failed: %d\n", (int)ret);
+    else if (got != len || rt_memcmp(tx, rx, len) != 0)
+        rt_kprintf("recv failed: %d\n", (int)got);
+    else
+        rt_kprintf("%d bytes in %d ms\n", (int)len, (int)(start * 1000 / RT_TICK_PER_SECOND));
+
+    rt_device_control(isotp_can, RT_CAN_CMD_SET_MODE, (void *)mode);
+    isotp_close(&link);
+    rt_free(tx);
+    rt_free(rx);
+
+    return 0;
+}
+MSH_CMD_EXPORT(isotp_loop, ISO-TP self test in CAN loopback - isotp_loop [len] [block_size] [stmin]);
+#endif
+
+#endif /* BSP_USING_ISOTP */
@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2006-2022, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ */
+
+#ifndef DRV_ISOTP_H__
+#define DRV_ISOTP_H__
+
+#include <rtthread.h>
+#include <rtdevice.h>
+
+#define ISOTP_MAX_LEN           4095    /* 12-bit FF_DL, the 32-bit escape is not supported */
+
+struct isotp_stats
+{
+    rt_uint32_t tx_msgs;
+    rt_uint32_t rx_msgs;
+    rt_uint32_t rx_no_buf;      /* SF / FF while no buffer was posted, FF answered with overflow */
+    rt_uint32_t rx_aborted;     /* wrong sequence number, N_Cr timeout or FF during a reception */
+    rt_uint32_t fc_wait;        /* WAIT flow controls of the peer */
+};
+
+/* One ISO 15765-2 connection with normal addressing on can1. Only tx_id..stmin are filled in
+ * by the caller; rx_id == tx_id lets a node in RT_CAN_MODE_LOOPBACK talk to itself. */
+struct isotp_link
+{
+    rt_uint32_t tx_id;          /* our frames */
+    rt_uint32_t rx_id;          /* frames of the peer */
+    rt_uint8_t ide;             /* RT_CAN_STDID / RT_CAN_EXTID, both directions */
+    rt_uint8_t block_size;      /* offered in our flow control, 0: whole message in one block */
+    rt_uint8_t stmin;           /* offered in our flow control, 0x00..0x7F ms, 0xF1..0xF9 100..900 us */
+
+    /* owned by the driver, only touched in the CAN / timer interrupts or with them disabled */
+    rt_uint8_t tx_state;
+    rt_uint8_t tx_sn;
+    rt_uint8_t tx_bs;           /* block size of the peer */
+    rt_uint8_t tx_blk;          /* CFs sent in the current block */
+    rt_uint32_t tx_gap;         /* STmin of the peer in timer cycles */
+    const rt_uint8_t *tx_buf;   /* caller's data, frames are built straight from it */
+    rt_uint16_t tx_len;
+    rt_uint16_t tx_pos;
+    rt_err_t tx_result;
+    struct rt_completion tx_done;
+    struct rt_timer tx_timer;   /* N_Bs */
+
+    rt_uint8_t rx_state;
+    rt_uint8_t rx_sn;
+    rt_uint8_t rx_blk;
+    rt_bool_t rx_ready;         /* message complete, not collected yet */
+    rt_uint8_t *rx_buf;         /* posted by the caller, reassembled in place */
+    rt_size_t rx_size;
+    rt_uint16_t rx_len;
+    rt_uint16_t rx_pos;
+    rt_err_t rx_result;
+    struct rt_completion rx_done;
+    struct rt_timer rx_timer;   /* N_Cr */
+
+    struct isotp_stats stats;
+};
+
+rt_err_t isotp_open(struct isotp_link *link);
+void isotp_close(struct isotp_link *link);
+rt_err_t isotp_send(struct isotp_link *link, const void *data, rt_size_t len, rt_int32_t timeout);
+rt_err_t isotp_recv_post(struct isotp_link *link, void *buf, rt_size_t size);
+rt_ssize_t isotp_recv(struct isotp_link *link, void *buf, rt_size_t size, rt_int32_t timeout);
+
+#endif
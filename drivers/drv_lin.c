@@ -0,0 +1,541 @@
+/*
+ * Copyright (c) 2006-2022, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ */
+
+#include <rthw.h>
+#include <rtthread.h>
+#include <rtdevice.h>
+#include "board.h"
+#include "drv_lin.h"
+#include "drv_gpio.h"
+
+#ifdef BSP_USING_LIN
+
+#if defined(BSP_LIN_USING_UART1)
+#ifdef BSP_USING_UART1
+#error "UART1 is used by both uart1 and lin0"
+#endif
+#define LIN_UART            UART1
+#define LIN_IRQn            IRQ1_IRQ
+#define LIN_PERIPH_IRQ      IRQ0_15_UART1
+#define LIN_FUNMUX_RXD      FUNMUX_UART1_RXD
+#define LIN_FUNMUX_TXD      FUNMUX_UART1_TXD
+#define LIN_IRQHandler      IRQ1_Handler
+#elif defined(BSP_LIN_USING_UART2)
+#ifdef BSP_USING_UART2
+#error "UART2 is used by both uart2 and lin0"
+#endif
+#define LIN_UART            UART2
+#define LIN_IRQn            IRQ2_IRQ
+#define LIN_PERIPH_IRQ      IRQ0_15_UART2
+#define LIN_FUNMUX_RXD      FUNMUX_UART2_RXD
+#define LIN_FUNMUX_TXD      FUNMUX_UART2_TXD
+#define LIN_IRQHandler      IRQ2_Handler
+#elif defined(BSP_LIN_USING_UART3)
+#ifdef BSP_USING_UART3
+#error "UART3 is used by both uart3 and lin0"
+#endif
+#define LIN_UART            UART3
+#define LIN_IRQn            IRQ3_IRQ
+#define LIN_PERIPH_IRQ      IRQ0_15_UART3
+#define LIN_FUNMUX_RXD      FUNMUX_UART3_RXD
+#define LIN_FUNMUX_TXD      FUNMUX_UART3_TXD
+#define LIN_IRQHandler      IRQ3_Handler
+#else
+#error "Please select the UART used by lin0"
+#endif
+
+#define LIN_SYNC_BYTE       0x55
+#define LIN_NO_FRAME        0xFF
+
+enum
+{
+    LIN_STATE_IDLE,
+    LIN_STATE_BREAK,        /* master: break being generated */
+    LIN_STATE_SYNC,         /* waiting for the sync byte */
+    LIN_STATE_PID,          /* waiting for the protected identifier */
+    LIN_STATE_RESPONSE,     /* collecting data and checksum */
+};
+
+struct swm181_lin
+{
+    struct rt_device parent;
+    UART_TypeDef *UARTx;
+    struct lin_table table;
+    rt_uint8_t index[64];           /* frame ID -> table slot, LIN_NO_FRAME if not in the table */
+    rt_bool_t running;
+    struct rt_timer timer;          /* master: one schedule slot */
+    rt_uint8_t slot;
+    struct lin_frame *frame;        /* frame on the bus, RT_NULL when idle */
+    rt_uint8_t state;
+    rt_uint8_t pid;
+    rt_uint8_t tx_buf[11];          /* sync, PID, 8 data, checksum */
+    rt_uint8_t tx_len;
+    rt_uint8_t tx_pos;
+    rt_uint8_t *tx_resp;            /* our response within tx_buf, read back from the bus */
+    rt_uint8_t rx_buf[9];
+    rt_uint8_t rx_pos;
+};
+
+static struct swm181_lin lin_obj;
+
+/* ID0..ID5 plus P0 = ID0^ID1^ID2^ID4 and P1 = !(ID1^ID3^ID4^ID5) */
+static const rt_uint8_t lin_pid_table[64] =
+{
+    0x80, 0xC1, 0x42, 0x03, 0xC4, 0x85, 0x06, 0x47, 0x08, 0x49, 0xCA, 0x8B, 0x4C, 0x0D, 0x8E, 0xCF,
+    0x50, 0x11, 0x92, 0xD3, 0x14, 0x55, 0xD6, 0x97, 0xD8, 0x99, 0x1A, 0x5B, 0x9C, 0xDD, 0x5E, 0x1F,
+    0x20, 0x61, 0xE2, 0xA3, 0x64, 0x25, 0xA6, 0xE7, 0xA8, 0xE9, 0x6A, 0x2B, 0xEC, 0xAD, 0x2E, 0x6F,
+    0xF0, 0xB1, 0x32, 0x73, 0xB4, 0xF5, 0x76, 0x37, 0x78, 0x39, 0xBA, 0xFB, 0x3C, 0x7D, 0xFE, 0xBF,
+};
+
+static rt_uint8_t swm181_lin_checksum(const struct lin_frame *frame, rt_uint8_t pid, const rt_uint8_t *data)
+{
+    rt_uint16_t sum = 0;
+    int i;
+
+    /* diagnostic frames always use the classic checksum */
+    if (frame->checksum == LIN_CHECKSUM_ENHANCED && frame->id != 0x3C && frame->id != 0x3D)
+        sum = pid;
+
+    for (i = 0; i < frame->len; i++)
+    {
+        sum += data[i];
+        if (sum > 0xFF)
+            sum -= 0xFF;
+    }
+
+    return (rt_uint8_t)~sum;
+}
+
+rt_inline void swm181_lin_flag_clear(UART_TypeDef *UARTx, rt_uint32_t flag)
+{
+    /* write-one-to-clear, keep the enables */
+    UARTx->LINCR = (UARTx->LINCR & (UART_LINCR_BRKDETIE_Msk | UART_LINCR_GENBRKIE_Msk)) | flag;
+}
+
+static void swm181_lin_rx_flush(UART_TypeDef *UARTx)
+{
+    volatile rt_uint32_t data;
+
+    while (UARTx->CTRL & UART_CTRL_RXNE_Msk)
+        data = UARTx->DATA;
+    (void)data;
+}
+
+static void swm181_lin_tx_fill(struct swm181_lin *lin)
+{
+    UART_TypeDef *UARTx = lin->UARTx;
+
+    while (lin->tx_pos < lin->tx_len && !(UARTx->CTRL & UART_CTRL_TXFF_Msk))
+        UARTx->DATA = lin->tx_buf[lin->tx_pos++];
+
+    if (lin->tx_pos < lin->tx_len)
+        UART_INTTXThresholdEn(UARTx);
+    else
+        UART_INTTXThresholdDis(UARTx);
+}
+
+static void swm181_lin_finish(struct swm181_lin *lin, rt_err_t status)
+{
+    struct lin_frame *frame = lin->frame;
+
+    lin->state = LIN_STATE_IDLE;
+    if (frame == RT_NULL)
+        return;
+
+    lin->frame = RT_NULL;
+    frame->status = status;
+    if (lin->table.ind != RT_NULL)
+        lin->table.ind(frame);
+}
+
+/* append data and checksum of a frame we publish, the bytes come back on RX as well */
+static void swm181_lin_response_load(struct swm181_lin *lin)
+{
+    struct lin_frame *frame = lin->frame;
+
+    lin->tx_resp = RT_NULL;
+    if (frame->dir != LIN_DIR_PUBLISH)
+        return;
+
+    lin->tx_resp = &lin->tx_buf[lin->tx_len];
+    rt_memcpy(lin->tx_resp, frame->data, frame->len);
+    lin->tx_resp[frame->len] = swm181_lin_checksum(frame, lin->pid, frame->data);
+    lin->tx_len += frame->len + 1;
+}
+
+static void swm181_lin_response_done(struct swm181_lin *lin)
+{
+    struct lin_frame *frame = lin->frame;
+
+    if (lin->tx_resp != RT_NULL)
+    {
+        /* read back differs from what we sent: another node drove the bus */
+        if (rt_memcmp(lin->rx_buf, lin->tx_resp, frame->len + 1) != 0)
+        {
+            swm181_lin_finish(lin, -RT_EIO);
+            return;
+        }
+    }
+    else
+    {
+        if (lin->rx_buf[frame->len] != swm181_lin_checksum(frame, lin->pid, lin->rx_buf))
+        {
+            swm181_lin_finish(lin, -RT_ERROR);
+            return;
+        }
+        rt_memcpy(frame->data, lin->rx_buf, frame->len);
+    }
+
+    swm181_lin_finish(lin, RT_EOK);
+}
+
+static void swm181_lin_rx(struct swm181_lin *lin, rt_uint8_t byte)
+{
+    switch (lin->state)
+    {
+    case LIN_STATE_SYNC:
+        /* the break itself may still show up as a 0x00 with framing error */
+        if (byte == LIN_SYNC_BYTE)
+            lin->state = LIN_STATE_PID;
+        else if (byte != 0x00)
+            swm181_lin_finish(lin, -RT_EIO);
+        break;
+
+    case LIN_STATE_PID:
+        if (lin->table.master)
+        {
+            if (byte != lin->pid)
+            {
+                swm181_lin_finish(lin, -RT_EIO);
+                break;
+            }
+        }
+        else
+        {
+            rt_uint8_t slot;
+
+            if (byte != lin_pid_table[byte & 0x3F] ||
+                (slot = lin->index[byte & 0x3F]) == LIN_NO_FRAME)
+            {
+                /* parity error or a frame this node does not take part in */
+                lin->state = LIN_STATE_IDLE;
+                break;
+            }
+            lin->pid = byte;
+            lin->frame = &lin->table.frames[slot];
+            lin->tx_len = 0;
+            lin->tx_pos = 0;
+            swm181_lin_response_load(lin);
+            swm181_lin_tx_fill(lin);
+        }
+        lin->rx_pos = 0;
+        lin->state = LIN_STATE_RESPONSE;
+        break;
+
+    case LIN_STATE_RESPONSE:
+        lin->rx_buf[lin->rx_pos++] = byte;
+        if (lin->rx_pos == lin->frame->len + 1)
+            swm181_lin_response_done(lin);
+        break;
+
+    default:
+        break;
+    }
+}
+
+/* master: break is out, send sync and PID and, for a published frame, the response */
+static void swm181_lin_header_send(struct swm181_lin *lin)
+{
+    lin->tx_buf[0] = LIN_SYNC_BYTE;
+    lin->tx_buf[1] = lin->pid;
+    lin->tx_len = 2;
+    lin->tx_pos = 0;
+    swm181_lin_response_load(lin);
+
+    lin->state = LIN_STATE_SYNC;
+    swm181_lin_tx_fill(lin);
+}
+
+static void swm181_lin_slot_timeout(void *parameter)
+{
+    struct swm181_lin *lin = (struct swm181_lin *)parameter;
+    struct lin_frame *frame;
+    rt_tick_t tick;
+
+    /* nobody answered the previous header within its slot */
+    swm181_lin_finish(lin, -RT_ETIMEOUT);
+    if (!lin->running)
+        return;
+
+    lin->slot = (lin->slot + 1) % lin->table.count;
+    frame = &lin->table.frames[lin->slot];
+    lin->frame = frame;
+    lin->pid = lin_pid_table[frame->id];
+    lin->state = LIN_STATE_BREAK;
+    UART_INTTXThresholdDis(lin->UARTx);
+    UART_LINGenerate(lin->UARTx);
+
+    tick = rt_tick_from_millisecond(frame->slot_ms);
+    rt_timer_control(&lin->timer, RT_TIMER_CTRL_SET_TIME, &tick);
+    rt_timer_start(&lin->timer);
+}
+
+static void swm181_lin_isr(struct swm181_lin *lin)
+{
+    UART_TypeDef *UARTx = lin->UARTx;
+    rt_uint32_t lincr = UARTx->LINCR;
+
+    if (lincr & UART_LINCR_GENBRKIF_Msk)
+    {
+        swm181_lin_flag_clear(UARTx, UART_LINCR_GENBRKIF_Msk);
+        swm181_lin_rx_flush(UARTx);
+        if (lin->state == LIN_STATE_BREAK)
+            swm181_lin_header_send(lin);
+    }
+
+    if (lincr & UART_LINCR_BRKDETIF_Msk)
+    {
+        swm181_lin_flag_clear(UARTx, UART_LINCR_BRKDETIF_Msk);
+        /* slave: a new header, whatever was in flight did not complete */
+        swm181_lin_finish(lin, -RT_ETIMEOUT);
+        swm181_lin_rx_flush(UARTx);
+        UART_INTTXThresholdDis(UARTx);
+        lin->state = LIN_STATE_SYNC;
+    }
+
+    while (UARTx->CTRL & UART_CTRL_RXNE_Msk)
+        swm181_lin_rx(lin, (rt_uint8_t)(UARTx->DATA & 0xFF));
+
+    if (UARTx->BAUD & UART_BAUD_TXIF_Msk)
+        swm181_lin_tx_fill(lin);
+}
+
+void LIN_IRQHandler(void)
+{
+    rt_interrupt_enter();
+    swm181_lin_isr(&lin_obj);
+    rt_interrupt_leave();
+}
+
+static void swm181_lin_stop(struct swm181_lin *lin)
+{
+    rt_base_t level;
+
+    rt_timer_stop(&lin->timer);
+
+    level = rt_hw_interrupt_disable();
+    lin->running = RT_FALSE;
+    UART_LINConfig(lin->UARTx, 0, 0);
+    UART_INTTXThresholdDis(lin->UARTx);
+    lin->state = LIN_STATE_IDLE;
+    lin->frame = RT_NULL;
+    rt_hw_interrupt_enable(level);
+}
+
+static rt_err_t swm181_lin_table_set(struct swm181_lin *lin, struct lin_table *table)
+{
+    int i;
+
+    if (lin->running)
+        return -RT_EBUSY;
+    if (table == RT_NULL || table->frames == RT_NULL || table->count == 0)
+        return -RT_EINVAL;
+
+    for (i = 0; i < table->count; i++)
+    {
+        struct lin_frame *frame = &table->frames[i];
+
+        if (frame->id > 0x3F || frame->len == 0 || frame->len > 8)
+            return -RT_EINVAL;
+        if (table->master && frame->slot_ms == 0)
+            return -RT_EINVAL;
+    }
+
+    rt_memset(lin->index, LIN_NO_FRAME, sizeof(lin->index));
+    for (i = 0; i < table->count; i++)
+        lin->index[table->frames[i].id] = i;
+    lin->table = *table;
+
+    return RT_EOK;
+}
+
+static rt_err_t swm181_lin_open(rt_device_t dev, rt_uint16_t oflag)
+{
+    struct swm181_lin *lin = (struct swm181_lin *)dev;
+    UART_InitStructure UART_initStruct;
+
+    UART_initStruct.Baudrate = BSP_LIN_BAUD;
+    UART_initStruct.DataBits = UART_DATA_8BIT;
+    UART_initStruct.Parity = UART_PARITY_NONE;
+    UART_initStruct.StopBits = UART_STOP_1BIT;
+    /* every byte is checked as it arrives */
+    UART_initStruct.RXThreshold = 0;
+    UART_initStruct.RXThresholdIEn = 1;
+    UART_initStruct.TXThreshold = 3;
+    UART_initStruct.TXThresholdIEn = 0;
+    UART_initStruct.TimeoutTime = 10;
+    UART_initStruct.TimeoutIEn = 0;
+    UART_Init(lin->UARTx, &UART_initStruct);
+    UART_LINConfig(lin->UARTx, 0, 0);
+
+    IRQ_Connect(LIN_PERIPH_IRQ, LIN_IRQn, 1);
+    UART_Open(lin->UARTx);
+
+    return RT_EOK;
+}
+
+static rt_err_t swm181_lin_close(rt_device_t dev)
+{
+    struct swm181_lin *lin = (struct swm181_lin *)dev;
+
+    swm181_lin_stop(lin);
+    NVIC_DisableIRQ(LIN_IRQn);
+    UART_Close(lin->UARTx);
+
+    return RT_EOK;
+}
+
+/* pos is the frame ID, the data is the latest response seen on the bus */
+static rt_ssize_t swm181_lin_read(rt_device_t dev, rt_off_t pos, void *buffer, rt_size_t size)
+{
+    struct swm181_lin *lin = (struct swm181_lin *)dev;
+    struct lin_frame *frame;
+    rt_base_t level;
+
+    if (pos < 0 || pos > 0x3F || lin->index[pos] == LIN_NO_FRAME)
+        return 0;
+
+    frame = &lin->table.frames[lin->index[pos]];
+    if (size > frame->len)
+        size = frame->len;
+
+    level = rt_hw_interrupt_disable();
+    rt_memcpy(buffer, frame->data, size);
+    rt_hw_interrupt_enable(level);
+
+    return size;
+}
+
+/* pos is the frame ID, updates the response this node publishes */
+static rt_ssize_t swm181_lin_write(rt_device_t dev, rt_off_t pos, const void *buffer, rt_size_t size)
+{
+    struct swm181_lin *lin = (struct swm181_lin *)dev;
+    struct lin_frame *frame;
+    rt_base_t level;
+
+    if (pos < 0 || pos > 0x3F || lin->index[pos] == LIN_NO_FRAME)
+        return 0;
+
+    frame = &lin->table.frames[lin->index[pos]];
+    if (frame->dir != LIN_DIR_PUBLISH)
+        return 0;
+    if (size > frame->len)
+        size = frame->len;
+
+    level = rt_hw_interrupt_disable();
+    rt_memcpy(frame->data, buffer, size);
+    rt_hw_interrupt_enable(level);
+
+    return size;
+}
+
+static rt_err_t swm181_lin_control(rt_device_t dev, int cmd, void *args)
+{
+    struct swm181_lin *lin = (struct swm181_lin *)dev;
+    rt_tick_t tick = 1;
+
+    switch (cmd)
+    {
+    case LIN_CTRL_SET_TABLE:
+        return swm181_lin_table_set(lin, (struct lin_table *)args);
+
+    case LIN_CTRL_START:
+        if (lin->table.frames == RT_NULL)
+            return -RT_EINVAL;
+        if (lin->running)
+            return -RT_EBUSY;
+
+        lin->state = LIN_STATE_IDLE;
+        lin->frame = RT_NULL;
+        lin->running = RT_TRUE;
+        if (lin->table.master)
+        {
+            UART_LINConfig(lin->UARTx, 0, 1);
+            /* the first timeout sends frames[0] */
+            lin->slot = lin->table.count - 1;
+            rt_timer_control(&lin->timer, RT_TIMER_CTRL_SET_TIME, &tick);
+            rt_timer_start(&lin->timer);
+        }
+        else
+        {
+            UART_LINConfig(lin->UARTx, 1, 0);
+        }
+        NVIC_EnableIRQ(LIN_IRQn);
+        break;
+
+    case LIN_CTRL_STOP:
+        swm181_lin_stop(lin);
+        break;
+
+    default:
+        return -RT_EINVAL;
+    }
+
+    return RT_EOK;
+}
+
+#ifdef RT_USING_DEVICE_OPS
+const static struct rt_device_ops swm181_lin_ops =
+{
+    RT_NULL,
+    swm181_lin_open,
+    swm181_lin_close,
+    swm181_lin_read,
+    swm181_lin_write,
+    swm181_lin_control
+};
+#endif
+
+int rt_hw_lin_init(void)
+{
+    struct swm181_lin *lin = &lin_obj;
+    rt_base_t rx_pin = rt_pin_get(BSP_LIN_RX_PIN);
+    rt_base_t tx_pin = rt_pin_get(BSP_LIN_TX_PIN);
+
+    if (rx_pin < 0 || tx_pin < 0)
+    {
+        rt_kprintf("lin pin lookup failed: rx=%s tx=%s\n", BSP_LIN_RX_PIN, BSP_LIN_TX_PIN);
+        return -RT_ERROR;
+    }
+
+    PORT_Init(SWM181_PIN_GET_PORT_PTR(rx_pin), SWM181_PIN_GET_PIN_IDX(rx_pin), LIN_FUNMUX_RXD, 1);
+    PORT_Init(SWM181_PIN_GET_PORT_PTR(tx_pin), SWM181_PIN_GET_PIN_IDX(tx_pin), LIN_FUNMUX_TXD, 0);
+
+    lin->UARTx = LIN_UART;
+    rt_memset(lin->index, LIN_NO_FRAME, sizeof(lin->index));
+    rt_timer_init(&lin->timer, "lin0", swm181_lin_slot_timeout, lin,
+                  1, RT_TIMER_FLAG_ONE_SHOT | RT_TIMER_FLAG_HARD_TIMER);
+
+    lin->parent.type = RT_Device_Class_Miscellaneous;
+#ifdef RT_USING_DEVICE_OPS
+    lin->parent.ops = &swm181_lin_ops;
+#else
+    lin->parent.init = RT_NULL;
+    lin->parent.open = swm181_lin_open;
+    lin->parent.close = swm181_lin_close;
+    lin->parent.read = swm181_lin_read;
+    lin->parent.write = swm181_lin_write;
+    lin->parent.control = swm181_lin_control;
+#endif
+
+    return rt_device_register(&lin->parent, "lin0", RT_DEVICE_FLAG_RDWR);
+}
+INIT_DEVICE_EXPORT(rt_hw_lin_init);
+
+#endif /* BSP_USING_LIN */
@@ -0,0 +1,47 @@
+/*
+ * Copyright (c) 2006-2022, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ */
+
+#ifndef DRV_LIN_H__
+#define DRV_LIN_H__
+
+#include <rtthread.h>
+
+/* rt_device_control() commands of "lin0" */
+#define LIN_CTRL_SET_TABLE      (RT_DEVICE_CTRL_BASE(Char) + 0x20)     /* arg: struct lin_table * */
+#define LIN_CTRL_START          (RT_DEVICE_CTRL_BASE(Char) + 0x21)     /* master: start the schedule */
+#define LIN_CTRL_STOP           (RT_DEVICE_CTRL_BASE(Char) + 0x22)
+
+#define LIN_DIR_PUBLISH         0   /* this node sends the response */
+#define LIN_DIR_SUBSCRIBE       1   /* this node receives the response */
+
+#define LIN_CHECKSUM_CLASSIC    0   /* data only, always used for the diagnostic IDs 0x3C/0x3D */
+#define LIN_CHECKSUM_ENHANCED   1   /* data and PID, LIN 2.x */
+
+struct lin_frame
+{
+    rt_uint8_t id;              /* frame identifier 0..63 */
+    rt_uint8_t dir;             /* LIN_DIR_xxx */
+    rt_uint8_t len;             /* response length 1..8 */
+    rt_uint8_t checksum;        /* LIN_CHECKSUM_xxx */
+    rt_uint16_t slot_ms;        /* master: time from this header to the next one */
+    rt_err_t status;            /* result of the last transfer, -RT_ETIMEOUT if nobody answered */
+    rt_uint8_t data[8];
+};
+
+struct lin_table
+{
+    struct lin_frame *frames;   /* owned by the caller, must stay valid while installed */
+    rt_uint8_t count;
+    rt_uint8_t master;          /* RT_TRUE: run frames[] as schedule table, RT_FALSE: slave */
+    void (*ind)(struct lin_frame *frame);   /* called from the ISR after every frame */
+};
+
+int rt_hw_lin_init(void);
+
+#endif
@@ -20,13 +20,329 @@
 #error "Please define at least one BSP_USING_SPIx"
 #endif
 
+/* RX and TX FIFO depth in words. At most this many words are kept in flight, so the TX
+ * FIFO never runs dry while RX is drained and RX can never overflow. */
+#define SWM181_SPI_FIFO_DEPTH   8
+
+/* devices per bus whose CTRL word is remembered */
+#define SWM181_SPI_CFG_CACHE    4
+
+struct swm181_spi_cfg_cache
+{
+    struct rt_spi_device *device;
+    rt_uint32_t max_hz;
+    rt_uint16_t mode;
+    rt_uint8_t data_width;
+    rt_uint32_t ctrl;
+};
+
+#if defined(BSP_SPI0_SLAVE) || defined(BSP_SPI1_SLAVE)
+#define SWM181_SPI_USING_SLAVE
+#endif
+
+/* completed slave frames waiting to be read */
+#define SWM181_SPIS_FRAMES      8
+
+struct swm181_spi_slave
+{
+    struct rt_device parent;
+    struct swm181_spi_bus *bus;
+    const char *name;
+    const char *cs_pin_name;
+    rt_base_t cs_pin;               /* frame edges, wired to (or being) the SSEL pad */
+    rt_uint8_t mode;                /* RT_SPI_CPOL / RT_SPI_CPHA */
+    struct rt_ringbuffer rx_rb;
+    struct rt_ringbuffer tx_rb;     /* shifted out to the master as it clocks */
+    rt_uint16_t frame_len[SWM181_SPIS_FRAMES];
+    rt_uint8_t frame_head;
+    rt_uint8_t frame_count;
+    rt_uint16_t cur_len;            /* bytes of the frame in progress that made it into rx_rb */
+    struct swm181_spi_slave_stats stats;
+};
+
 struct swm181_spi_bus
 {
     struct rt_spi_bus parent;
     SPI_TypeDef *SPIx;
     const char *name;
+    IRQn_Type irqn;
+    uint32_t periph_irq;
+    struct rt_completion done;      /* interrupt transfer finished */
+    const rt_uint8_t *send;         /* interrupt transfer state, owned by the ISR while running */
+    rt_uint8_t *recv;
+    rt_uint32_t len;
+    rt_uint32_t tx;
+    rt_uint32_t rx;
+    rt_bool_t word16;
+    rt_uint32_t ctrl;               /* CTRL word currently programmed, 0 before the first configure */
+    struct swm181_spi_cfg_cache cache[SWM181_SPI_CFG_CACHE];
+    rt_uint8_t cache_next;
+    struct swm181_spi_slave *slave; /* not RT_NULL: the port runs as a slave, no bus is registered */
 };
 
+#define SWM181_SPI_XFER_FUNCS(bits, type, dummy)                                                \
+static void swm181_spi_txrx##bits(SPI_TypeDef *SPIx, const type *send, type *recv, rt_uint32_t len) \
+{                                                                                               \
+    rt_uint32_t tx = 0, rx = 0, stat;                                                           \
+                                                                                                \
+    while (rx < len)                                                                            \
+    {                                                                                           \
+        stat = SPIx->STAT;                                                                      \
+        if (tx < len && tx - rx < SWM181_SPI_FIFO_DEPTH && (stat & SPI_STAT_TFNF_Msk))          \
+            SPIx->DATA = send[tx++];                                                            \
+        if (stat & SPI_STAT_RFNE_Msk)                                                           \
+            recv[rx++] = (type)SPIx->DATA;                                                      \
+    }                                                                                           \
+}                                                                                               \
+                                                                                                \
+static void swm181_spi_tx##bits(SPI_TypeDef *SPIx, const type *send, rt_uint32_t len)          \
+{                                                                                               \
+    rt_uint32_t tx = 0, rx = 0, stat;                                                           \
+                                                                                                \
+    while (rx < len)                                                                            \
+    {                                                                                           \
+        stat = SPIx->STAT;                                                                      \
+        if (tx < len && tx - rx < SWM181_SPI_FIFO_DEPTH && (stat & SPI_STAT_TFNF_Msk))          \
+            SPIx->DATA = send[tx++];                                                            \
+        if (stat & SPI_STAT_RFNE_Msk)                                                           \
+        {                                                                                       \
+            (void)SPIx->DATA;                                                                   \
+            rx++;                                                                               \
+        }                                                                                       \
+    }                                                                                           \
+}                                                                                               \
+                                                                                                \
+static void swm181_spi_rx##bits(SPI_TypeDef *SPIx, type *recv, rt_uint32_t len)                \
+{                                                                                               \
+    rt_uint32_t tx = 0, rx = 0, stat;                                                           \
+                                                                                                \
+    while (rx < len)                                                                            \
+    {                                                                                           \
+        stat = SPIx->STAT;                                                                      \
+        if (tx < len && tx - rx < SWM181_SPI_FIFO_DEPTH && (stat & SPI_STAT_TFNF_Msk))          \
+        {                                                                                       \
+            SPIx->DATA = dummy;                                                                 \
+            tx++;                                                                               \
+        }                                                                                       \
+        if (stat & SPI_STAT_RFNE_Msk)                                                           \
+            recv[rx++] = (type)SPIx->DATA;                                                      \
+    }                                                                                           \
+}
+
+SWM181_SPI_XFER_FUNCS(8, rt_uint8_t, 0xFF)
+SWM181_SPI_XFER_FUNCS(16, rt_uint16_t, 0xFFFF)
+
+/* neither buffer given: only clock out dummy words, e.g. SD card power-up */
+static void swm181_spi_clock(SPI_TypeDef *SPIx, rt_uint32_t len)
+{
+    rt_uint16_t scratch[SWM181_SPI_FIFO_DEPTH];
+    rt_uint32_t n;
+
+    while (len)
+    {
+        n = len < SWM181_SPI_FIFO_DEPTH ? len : SWM181_SPI_FIFO_DEPTH;
+        swm181_spi_rx16(SPIx, scratch, n);
+        len -= n;
+    }
+}
+
+#ifdef BSP_SPI0_SLAVE
+static rt_uint8_t spis0_rx_pool[BSP_SPI_SLAVE_RX_BUFSZ];
+static rt_uint8_t spis0_tx_pool[BSP_SPI_SLAVE_TX_BUFSZ];
+static struct swm181_spi_slave spis0 = { .name = "spis0", .cs_pin_name = BSP_SPI0_SLAVE_CS_PIN };
+#define SPI0_SLAVE &spis0
+#else
+#define SPI0_SLAVE RT_NULL
+#endif
+#ifdef BSP_SPI1_SLAVE
+static rt_uint8_t spis1_rx_pool[BSP_SPI_SLAVE_RX_BUFSZ];
+static rt_uint8_t spis1_tx_pool[BSP_SPI_SLAVE_TX_BUFSZ];
+static struct swm181_spi_slave spis1 = { .name = "spis1", .cs_pin_name = BSP_SPI1_SLAVE_CS_PIN };
+#define SPI1_SLAVE &spis1
+#else
+#define SPI1_SLAVE RT_NULL
+#endif
+
+static struct swm181_spi_bus spi_objs[] = {
+#ifdef BSP_USING_SPI0
+    { .SPIx = SPI0, .name = "spi0", .irqn = IRQ9_IRQ, .periph_irq = IRQ0_15_SPI0, .slave = SPI0_SLAVE },
+#endif
+#ifdef BSP_USING_SPI1
+    { .SPIx = SPI1, .name = "spi1", .irqn = IRQ10_IRQ, .periph_irq = IRQ0_15_SPI1, .slave = SPI1_SLAVE },
+#endif
+};
+
+#ifdef SWM181_SPI_USING_SLAVE
+/* slave: move received words into the ring, keep the TX FIFO topped up from the other ring */
+static void swm181_spi_slave_pump(struct swm181_spi_slave *slave)
+{
+    SPI_TypeDef *SPIx = slave->bus->SPIx;
+    rt_uint8_t ch;
+
+    while (SPIx->STAT & SPI_STAT_RFNE_Msk)
+    {
+        ch = (rt_uint8_t)SPIx->DATA;
+        if (rt_ringbuffer_putchar(&slave->rx_rb, ch))
+            slave->cur_len++;
+        else
+            slave->stats.rx_drops++;
+        slave->stats.rx_bytes++;
+    }
+
+    while ((SPIx->STAT & SPI_STAT_TFNF_Msk) && rt_ringbuffer_getchar(&slave->tx_rb, &ch))
+        SPIx->DATA = ch;
+}
+
+static void swm181_spi_slave_isr(struct swm181_spi_slave *slave)
+{
+    SPI_TypeDef *SPIx = slave->bus->SPIx;
+
+    if (SPI_INTRXOverflowStat(SPIx))
+    {
+        SPI_INTRXOverflowClr(SPIx);
+        slave->stats.overruns++;
+    }
+    SPI_INTRXHalfFullClr(SPIx);
+
+    swm181_spi_slave_pump(slave);
+}
+
+/* CS edge: falling starts a frame, rising closes it and hands it to the reader */
+static void swm181_spi_slave_cs_isr(void *args)
+{
+    struct swm181_spi_slave *slave = (struct swm181_spi_slave *)args;
+    rt_uint16_t len;
+
+    swm181_spi_slave_pump(slave);
+    if (rt_pin_read(slave->cs_pin) == PIN_LOW)
+        return;
+
+    len = slave->cur_len;
+    slave->cur_len = 0;
+    if (len == 0)
+        return;
+
+    slave->stats.frames++;
+    if (slave->frame_count < SWM181_SPIS_FRAMES)
+    {
+        slave->frame_len[(slave->frame_head + slave->frame_count) % SWM181_SPIS_FRAMES] = len;
+        slave->frame_count++;
+    }
+    else
+    {
+        /* no slot left: the bytes join the newest frame */
+        slave->frame_len[(slave->frame_head + SWM181_SPIS_FRAMES - 1) % SWM181_SPIS_FRAMES] += len;
+        slave->stats.frame_merges++;
+    }
+
+    if (slave->parent.rx_indicate != RT_NULL)
+        slave->parent.rx_indicate(&slave->parent, len);
+}
+#endif /* SWM181_SPI_USING_SLAVE */
+
+static void swm181_spi_isr(struct swm181_spi_bus *bus)
+{
+    SPI_TypeDef *SPIx = bus->SPIx;
+    rt_uint32_t data;
+
+#ifdef SWM181_SPI_USING_SLAVE
+    if (bus->slave != RT_NULL)
+    {
+        swm181_spi_slave_isr(bus->slave);
+        return;
+    }
+#endif
+
+    SPIx->IF = SPI_IF_RFHF_Msk | SPI_IF_TFE_Msk;
+
+    while (1)
+    {
+        while (SPIx->STAT & SPI_STAT_RFNE_Msk)
+        {
+            data = SPIx->DATA;
+            if (bus->recv)
+            {
+                if (bus->word16)
+                    ((rt_uint16_t *)bus->recv)[bus->rx] = (rt_uint16_t)data;
+                else
+                    bus->recv[bus->rx] = (rt_uint8_t)data;
+            }
+            bus->rx++;
+        }
+
+        while (bus->tx < bus->len && bus->tx - bus->rx < SWM181_SPI_FIFO_DEPTH && (SPIx->STAT & SPI_STAT_TFNF_Msk))
+        {
+            if (bus->send == RT_NULL)
+                data = 0xFFFF;
+            else if (bus->word16)
+                data = ((const rt_uint16_t *)bus->send)[bus->tx];
+            else
+                data = bus->send[bus->tx];
+            SPIx->DATA = data;
+            bus->tx++;
+        }
+
+        /* the tail never reaches half full: once TX is empty at most one word is still shifting */
+        if (bus->rx == bus->len || bus->tx < bus->len || !(SPIx->STAT & SPI_STAT_TFE_Msk))
+            break;
+    }
+
+    if (bus->rx == bus->len)
+    {
+        SPIx->IE &= ~(SPI_IE_RFHF_Msk | SPI_IE_TFE_Msk);
+        rt_completion_done(&bus->done);
+    }
+    else if (bus->tx == bus->len)
+    {
+        SPI_INTRXHalfFullDis(SPIx);
+        SPI_INTTXEmptyEn(SPIx);
+    }
+}
+
+#ifdef BSP_USING_SPI0
+void IRQ9_Handler(void)
+{
+    rt_interrupt_enter();
+    swm181_spi_isr(&spi_objs[0]);
+    rt_interrupt_leave();
+}
+#endif
+
+#ifdef BSP_USING_SPI1
+void IRQ10_Handler(void)
+{
+    rt_interrupt_enter();
+    int idx = 0;
+#ifdef BSP_USING_SPI0
+    idx++;
+#endif
+    swm181_spi_isr(&spi_objs[idx]);
+    rt_interrupt_leave();
+}
+#endif
+
+/* the calling thread sleeps while the ISR keeps the FIFOs moving */
+static void swm181_spi_xfer_int(struct swm181_spi_bus *bus, const void *send, void *recv,
+                                rt_uint32_t cnt, rt_bool_t word16)
+{
+    bus->send = (const rt_uint8_t *)send;
+    bus->recv = (rt_uint8_t *)recv;
+    bus->len = cnt;
+    bus->tx = 0;
+    bus->rx = 0;
+    bus->word16 = word16;
+
+    rt_completion_init(&bus->done);
+    bus->SPIx->IF = SPI_IF_RFHF_Msk | SPI_IF_TFE_Msk;
+    NVIC_DisableIRQ(bus->irqn);
+    swm181_spi_isr(bus);
+    if (bus->rx != bus->len && bus->tx != bus->len)
+        SPI_INTRXHalfFullEn(bus->SPIx);
+    NVIC_EnableIRQ(bus->irqn);
+
+    rt_completion_wait(&bus->done, RT_WAITING_FOREVER);
+}
+
 static rt_uint8_t swm181_spi_clkdiv(rt_uint32_t max_hz)
 {
     rt_uint32_t div;
@@ -46,20 +362,64 @@ static rt_uint8_t swm181_spi_clkdiv(rt_uint32_t max_hz)
     return SPI_CLKDIV_512;
 }
 
+/* CTRL word (without EN) for a configuration, remembered per device so a device taking the bus
+ * back is matched without recomputing the divider */
+static rt_uint32_t swm181_spi_ctrl_get(struct swm181_spi_bus *bus, struct rt_spi_device *device,
+                                       struct rt_spi_configuration *cfg)
+{
+    struct swm181_spi_cfg_cache *slot = RT_NULL;
+    int i;
+
+    for (i = 0; i < SWM181_SPI_CFG_CACHE; i++)
+    {
+        if (bus->cache[i].device == device)
+        {
+            slot = &bus->cache[i];
+            if (slot->max_hz == cfg->max_hz && slot->mode == cfg->mode && slot->data_width == cfg->data_width)
+                return slot->ctrl;
+            break;
+        }
+    }
+    if (slot == RT_NULL)
+    {
+        slot = &bus->cache[bus->cache_next];
+        bus->cache_next = (bus->cache_next + 1) % SWM181_SPI_CFG_CACHE;
+    }
+
+    slot->device = device;
+    slot->max_hz = cfg->max_hz;
+    slot->mode = cfg->mode;
+    slot->data_width = cfg->data_width;
+    slot->ctrl = (SPI_FORMAT_SPI << SPI_CTRL_FFS_Pos) |
+                 (((cfg->mode & RT_SPI_CPHA) ? SPI_SECOND_EDGE : SPI_FIRST_EDGE) << SPI_CTRL_CPHA_Pos) |
+                 (((cfg->mode & RT_SPI_CPOL) ? SPI_HIGH_LEVEL : SPI_LOW_LEVEL) << SPI_CTRL_CPOL_Pos) |
+                 ((cfg->data_width - 1) << SPI_CTRL_DSS_Pos) |
+                 (((cfg->mode & RT_SPI_SLAVE) ? 0 : 1) << SPI_CTRL_MSTR_Pos) |
+                 (swm181_spi_clkdiv(cfg->max_hz) << SPI_CTRL_CLKDIV_Pos);
+
+    return slot->ctrl;
+}
+
 static rt_err_t swm181_spi_configure(struct rt_spi_device *device,
                                   struct rt_spi_configuration *configuration)
 {
     struct swm181_spi_bus *bus = (struct swm181_spi_bus *)device->bus;
     SPI_TypeDef *SPIx = bus->SPIx;
     SPI_InitStructure init_struct;
+    rt_uint32_t ctrl;
 
     if (configuration->data_width < 4 || configuration->data_width > 16)
         return -RT_EINVAL;
 
+    /* the bus core calls this on every change of owner; skip it when nothing differs */
+    ctrl = swm181_spi_ctrl_get(bus, device, configuration);
+    if (ctrl == bus->ctrl)
+        return RT_EOK;
+
     init_struct.FrameFormat = SPI_FORMAT_SPI;
     init_struct.WordSize = configuration->data_width;
     init_struct.Master = (configuration->mode & RT_SPI_SLAVE) ? 0 : 1;
-    init_struct.clkDiv = swm181_spi_clkdiv(configuration->max_hz);
+    init_struct.clkDiv = (ctrl & SPI_CTRL_CLKDIV_Msk) >> SPI_CTRL_CLKDIV_Pos;
     init_struct.SampleEdge = (configuration->mode & RT_SPI_CPHA) ? SPI_SECOND_EDGE : SPI_FIRST_EDGE;
     init_struct.IdleLevel = (configuration->mode & RT_SPI_CPOL) ? SPI_HIGH_LEVEL : SPI_LOW_LEVEL;
     init_struct.RXHFullIEn = 0;
@@ -68,6 +428,7 @@ static rt_err_t swm181_spi_configure(struct rt_spi_device *device,
 
     SPI_Init(SPIx, &init_struct);
     SPI_Open(SPIx);
+    bus->ctrl = ctrl;
 
     return RT_EOK;
 }
@@ -78,39 +439,50 @@ static rt_ssize_t swm181_spi_xfer(struct rt_spi_device *device, struct rt_spi_me
     struct rt_spi_configuration *cfg = &device->config;
     rt_base_t cs_pin = device->cs_pin;
     SPI_TypeDef *SPIx = bus->SPIx;
-    rt_uint32_t i;
     rt_uint8_t cs_active = (cfg->mode & RT_SPI_CS_HIGH) ? PIN_HIGH : PIN_LOW;
     rt_uint8_t cs_inactive = (cfg->mode & RT_SPI_CS_HIGH) ? PIN_LOW : PIN_HIGH;
 
     if ((cfg->mode & RT_SPI_NO_CS) == 0 && cs_pin != -1)
     {
-        rt_pin_mode(cs_pin, PIN_MODE_OUTPUT);
         if (message->cs_take)
             rt_pin_write(cs_pin, cs_active);
     }
 
-    if (cfg->data_width <= 8)
+    if (BSP_SPI_INT_THRESHOLD != 0 &&
+        message->length / (cfg->data_width <= 8 ? 1 : 2) >= BSP_SPI_INT_THRESHOLD &&
+        rt_interrupt_get_nest() == 0 && rt_thread_self() != RT_NULL)
+    {
+        swm181_spi_xfer_int(bus, message->send_buf, message->recv_buf,
+                            message->length / (cfg->data_width <= 8 ? 1 : 2), cfg->data_width > 8);
+    }
+    else if (cfg->data_width <= 8)
     {
         const rt_uint8_t *send = (const rt_uint8_t *)message->send_buf;
         rt_uint8_t *recv = (rt_uint8_t *)message->recv_buf;
-        for (i = 0; i < message->length; i++)
-        {
-            rt_uint8_t out = send ? send[i] : 0xFF;
-            rt_uint8_t in = (rt_uint8_t)SPI_ReadWrite(SPIx, out);
-            if (recv) recv[i] = in;
-        }
+
+        if (send && recv)
+            swm181_spi_txrx8(SPIx, send, recv, message->length);
+        else if (send)
+            swm181_spi_tx8(SPIx, send, message->length);
+        else if (recv)
+            swm181_spi_rx8(SPIx, recv, message->length);
+        else
+            swm181_spi_clock(SPIx, message->length);
     }
     else
     {
         const rt_uint16_t *send16 = (const rt_uint16_t *)message->send_buf;
         rt_uint16_t *recv16 = (rt_uint16_t *)message->recv_buf;
         rt_uint32_t cnt = message->length / 2;
-        for (i = 0; i < cnt; i++)
-        {
-            rt_uint16_t out = send16 ? send16[i] : 0xFFFF;
-            rt_uint16_t in = (rt_uint16_t)SPI_ReadWrite(SPIx, out);
-            if (recv16) recv16[i] = in;
-        }
+
+        if (send16 && recv16)
+            swm181_spi_txrx16(SPIx, send16, recv16, cnt);
+        else if (send16)
+            swm181_spi_tx16(SPIx, send16, cnt);
+        else if (recv16)
+            swm181_spi_rx16(SPIx, recv16, cnt);
+        else
+            swm181_spi_clock(SPIx, cnt);
     }
 
     if ((cfg->mode & RT_SPI_NO_CS) == 0 && cs_pin != -1)
@@ -128,14 +500,179 @@ static const struct rt_spi_ops swm181_spi_ops =
     swm181_spi_xfer
 };
 
-static struct swm181_spi_bus spi_objs[] = {
-#ifdef BSP_USING_SPI0
-    { .SPIx = SPI0, .name = "spi0" },
+#ifdef SWM181_SPI_USING_SLAVE
+static rt_err_t swm181_spi_slave_open(rt_device_t dev, rt_uint16_t oflag)
+{
+    struct swm181_spi_slave *slave = (struct swm181_spi_slave *)dev;
+    SPI_TypeDef *SPIx = slave->bus->SPIx;
+    SPI_InitStructure init_struct;
+    rt_base_t level;
+
+    init_struct.FrameFormat = SPI_FORMAT_SPI;
+    init_struct.WordSize = 8;
+    init_struct.Master = 0;
+    init_struct.clkDiv = SPI_CLKDIV_4;
+    init_struct.SampleEdge = (slave->mode & RT_SPI_CPHA) ? SPI_SECOND_EDGE : SPI_FIRST_EDGE;
+    init_struct.IdleLevel = (slave->mode & RT_SPI_CPOL) ? SPI_HIGH_LEVEL : SPI_LOW_LEVEL;
+    init_struct.RXHFullIEn = 1;
+    init_struct.TXEmptyIEn = 0;
+    init_struct.TXCompleteIEn = 0;
+
+    level = rt_hw_interrupt_disable();
+    SPI_Init(SPIx, &init_struct);
+    SPI_INTRXOverflowEn(SPIx);
+    slave->cur_len = 0;
+    slave->frame_head = 0;
+    slave->frame_count = 0;
+    rt_ringbuffer_reset(&slave->rx_rb);
+    SPI_Open(SPIx);
+    /* preload what is already queued for the master */
+    swm181_spi_slave_pump(slave);
+    rt_hw_interrupt_enable(level);
+
+    rt_pin_irq_enable(slave->cs_pin, PIN_IRQ_ENABLE);
+    NVIC_EnableIRQ(slave->bus->irqn);
+
+    return RT_EOK;
+}
+
+static rt_err_t swm181_spi_slave_close(rt_device_t dev)
+{
+    struct swm181_spi_slave *slave = (struct swm181_spi_slave *)dev;
+
+    rt_pin_irq_enable(slave->cs_pin, PIN_IRQ_DISABLE);
+    NVIC_DisableIRQ(slave->bus->irqn);
+    SPI_Close(slave->bus->SPIx);
+
+    return RT_EOK;
+}
+
+/* returns at most the rest of the oldest complete frame, 0 if none has ended yet */
+static rt_ssize_t swm181_spi_slave_read(rt_device_t dev, rt_off_t pos, void *buffer, rt_size_t size)
+{
+    struct swm181_spi_slave *slave = (struct swm181_spi_slave *)dev;
+    rt_base_t level;
+    rt_size_t n = 0;
+
+    level = rt_hw_interrupt_disable();
+    if (slave->frame_count != 0)
+    {
+        n = slave->frame_len[slave->frame_head];
+        if (n > size)
+            n = size;
+        n = rt_ringbuffer_get(&slave->rx_rb, (rt_uint8_t *)buffer, n);
+        slave->frame_len[slave->frame_head] -= n;
+        if (slave->frame_len[slave->frame_head] == 0)
+        {
+            slave->frame_head = (slave->frame_head + 1) % SWM181_SPIS_FRAMES;
+            slave->frame_count--;
+        }
+    }
+    rt_hw_interrupt_enable(level);
+
+    return n;
+}
+
+/* queue data for the master to clock out; returns what fit into the ring */
+static rt_ssize_t swm181_spi_slave_write(rt_device_t dev, rt_off_t pos, const void *buffer, rt_size_t size)
+{
+    struct swm181_spi_slave *slave = (struct swm181_spi_slave *)dev;
+    rt_base_t level;
+    rt_size_t n;
+
+    level = rt_hw_interrupt_disable();
+    n = rt_ringbuffer_put(&slave->tx_rb, (const rt_uint8_t *)buffer, size);
+    if (dev->open_flag & RT_DEVICE_OFLAG_OPEN)
+        swm181_spi_slave_pump(slave);
+    rt_hw_interrupt_enable(level);
+
+    return n;
+}
+
+static rt_err_t swm181_spi_slave_control(rt_device_t dev, int cmd, void *args)
+{
+    struct swm181_spi_slave *slave = (struct swm181_spi_slave *)dev;
+    rt_base_t level;
+
+    switch (cmd)
+    {
+    case SWM181_SPIS_CTRL_SET_MODE:
+        if (args == RT_NULL)
+            return -RT_EINVAL;
+        /* takes effect at the next open */
+        slave->mode = *(rt_uint8_t *)args & (RT_SPI_CPOL | RT_SPI_CPHA);
+        break;
+
+    case SWM181_SPIS_CTRL_GET_STATS:
+        if (args == RT_NULL)
+            return -RT_EINVAL;
+        level = rt_hw_interrupt_disable();
+        *(struct swm181_spi_slave_stats *)args = slave->stats;
+        rt_hw_interrupt_enable(level);
+        break;
+
+    default:
+        return -RT_EINVAL;
+    }
+
+    return RT_EOK;
+}
+
+#ifdef RT_USING_DEVICE_OPS
+const static struct rt_device_ops swm181_spi_slave_ops =
+{
+    RT_NULL,
+    swm181_spi_slave_open,
+    swm181_spi_slave_close,
+    swm181_spi_slave_read,
+    swm181_spi_slave_write,
+    swm181_spi_slave_control
+};
 #endif
-#ifdef BSP_USING_SPI1
-    { .SPIx = SPI1, .name = "spi1" },
+
+static rt_err_t swm181_spi_slave_register(struct swm181_spi_bus *bus)
+{
+    struct swm181_spi_slave *slave = bus->slave;
+
+    slave->cs_pin = rt_pin_get(slave->cs_pin_name);
+    if (slave->cs_pin < 0)
+    {
+        rt_kprintf("spi pin lookup failed: %s cs=%s\n", slave->name, slave->cs_pin_name);
+        return -RT_ERROR;
+    }
+    rt_pin_attach_irq(slave->cs_pin, PIN_IRQ_MODE_RISING_FALLING, swm181_spi_slave_cs_isr, slave);
+
+    slave->bus = bus;
+#ifdef BSP_SPI0_SLAVE
+    if (slave == &spis0)
+    {
+        rt_ringbuffer_init(&slave->rx_rb, spis0_rx_pool, sizeof(spis0_rx_pool));
+        rt_ringbuffer_init(&slave->tx_rb, spis0_tx_pool, sizeof(spis0_tx_pool));
+    }
+#endif
+#ifdef BSP_SPI1_SLAVE
+    if (slave == &spis1)
+    {
+        rt_ringbuffer_init(&slave->rx_rb, spis1_rx_pool, sizeof(spis1_rx_pool));
+        rt_ringbuffer_init(&slave->tx_rb, spis1_tx_pool, sizeof(spis1_tx_pool));
+    }
+#endif
+
+    slave->parent.type = RT_Device_Class_Miscellaneous;
+#ifdef RT_USING_DEVICE_OPS
+    slave->parent.ops = &swm181_spi_slave_ops;
+#else
+    slave->parent.init = RT_NULL;
+    slave->parent.open = swm181_spi_slave_open;
+    slave->parent.close = swm181_spi_slave_close;
+    slave->parent.read = swm181_spi_slave_read;
+    slave->parent.write = swm181_spi_slave_write;
+    slave->parent.control = swm181_spi_slave_control;
 #endif
-};
+
+    return rt_device_register(&slave->parent, slave->name, RT_DEVICE_FLAG_RDWR);
+}
+#endif /* SWM181_SPI_USING_SLAVE */
 
 int rt_hw_spi_init(void)
 {
@@ -144,28 +681,48 @@ int rt_hw_spi_init(void)
     for (i = 0; i < sizeof(spi_objs) / sizeof(spi_objs[0]); i++)
     {
         struct swm181_spi_bus *bus = &spi_objs[i];
+        /* data direction of MISO, MOSI and SCLK flips in slave mode */
+        rt_uint32_t in = bus->slave ? 0 : 1;
 
         if (bus->SPIx == SPI0) {
 #if defined(BSP_SPI0_PIN_GRP_A)
             /* PA9(22), PA10(28), PA11(29) */
-            PORT_Init(PORTA, PIN9,  2, 1);
-            PORT_Init(PORTA, PIN10, 2, 0);
-            PORT_Init(PORTA, PIN11, 2, 0);
+            PORT_Init(PORTA, PIN9,  2, in);
+            PORT_Init(PORTA, PIN10, 2, !in);
+            PORT_Init(PORTA, PIN11, 2, !in);
+            if (bus->slave)
+                PORT_Init(PORTA, PIN8, 2, 1);
 #elif defined(BSP_SPI0_PIN_GRP_B)
             /* PA13(12), PA14(11), PA15(8) */
-            PORT_Init(PORTA, PIN13, 4, 1);
-            PORT_Init(PORTA, PIN14, 4, 0);
-            PORT_Init(PORTA, PIN15, 4, 0);
+            PORT_Init(PORTA, PIN13, 4, in);
+            PORT_Init(PORTA, PIN14, 4, !in);
+            PORT_Init(PORTA, PIN15, 4, !in);
+            if (bus->slave)
+                PORT_Init(PORTA, PIN12, 4, 1);
 #endif
         } else {
 #if defined(BSP_SPI1_PIN_FIXED)
             /* PC5(41), PC6(15), PC7(14) */
-            PORT_Init(PORTC, PIN5, 4, 1);
-            PORT_Init(PORTC, PIN6, 4, 0);
-            PORT_Init(PORTC, PIN7, 4, 0);
+            PORT_Init(PORTC, PIN5, 4, in);
+            PORT_Init(PORTC, PIN6, 4, !in);
+            PORT_Init(PORTC, PIN7, 4, !in);
+            if (bus->slave)
+                PORT_Init(PORTC, PIN4, 4, 1);
 #endif
         }
 
+        rt_completion_init(&bus->done);
+        IRQ_Connect(bus->periph_irq, bus->irqn, 2);
+
+#ifdef SWM181_SPI_USING_SLAVE
+        if (bus->slave)
+        {
+            /* enabled again by open */
+            NVIC_DisableIRQ(bus->irqn);
+            swm181_spi_slave_register(bus);
+            continue;
+        }
+#endif
         rt_spi_bus_register(&bus->parent, bus->name, &swm181_spi_ops);
     }
 
@@ -173,4 +730,131 @@ int rt_hw_spi_init(void)
 }
 INIT_DEVICE_EXPORT(rt_hw_spi_init);
 
+/* attach a device with its CS pin set up once here, the transfer path only toggles it */
+rt_err_t rt_hw_spi_device_attach(const char *bus_name, const char *device_name, rt_base_t cs_pin)
+{
+    struct rt_spi_device *spi_device;
+    rt_err_t result;
+
+    spi_device = (struct rt_spi_device *)rt_malloc(sizeof(struct rt_spi_device));
+    if (spi_device == RT_NULL)
+        return -RT_ENOMEM;
+
+    if (cs_pin != -1)
+    {
+        rt_pin_mode(cs_pin, PIN_MODE_OUTPUT);
+        rt_pin_write(cs_pin, PIN_HIGH);
+    }
+
+    result = rt_spi_bus_attach_device_cspin(spi_device, device_name, bus_name, cs_pin, RT_NULL);
+    if (result != RT_EOK)
+        rt_free(spi_device);
+
+    return result;
+}
+
+
+#if defined(RT_USING_FINSH) && defined(RT_USING_HEAP)
+#include <stdlib.h>
+
+#define SPIBENCH_TOTAL          (64 * 1024)
+
+/* core clock cycles since boot from the tick count and SysTick, which counts down and reloads
+ * once per tick; the M0 has no cycle counter */
+static rt_uint64_t swm181_spi_cycles(void)
+{
+    rt_tick_t tick;
+    rt_uint32_t val;
+
+    do
+    {
+        tick = rt_tick_get();
+        val = SysTick->VAL;
+    } while (tick != rt_tick_get());
+
+    return (rt_uint64_t)tick * (SysTick->LOAD + 1) + (SysTick->LOAD - val);
+}
+
+/* SPIBENCH_TOTAL bytes in messages of len bytes; the device only ever sees 0xFF */
+static void spibench_run(struct rt_spi_device *device, const char *name, const rt_uint8_t *send,
+                         rt_uint8_t *recv, rt_size_t len, rt_uint32_t sck)
+{
+    rt_uint32_t loops = (SPIBENCH_TOTAL + len - 1) / len;
+    rt_uint64_t bytes = (rt_uint64_t)loops * len;
+    rt_uint64_t cycles;
+    rt_uint32_t kbps, i;
+
+    cycles = swm181_spi_cycles();
+    for (i = 0; i < loops; i++)
+        rt_spi_transfer(device, send, recv, len);
+    cycles = swm181_spi_cycles() - cycles;
+
+    kbps = (rt_uint32_t)(bytes * SystemCoreClock / 1000 / cycles);
+    rt_kprintf("%-6s %4u.%03u MB/s  %3u%% of SCK  %u cycles/byte\n", name, kbps / 1000, kbps % 1000,
+               (rt_uint32_t)(bytes * 8 * 100 * SystemCoreClock / cycles / sck),
+               (rt_uint32_t)(cycles / bytes));
+}
+
+/* throughput of the transfer loops through the whole rt_spi_transfer path, CS and bus lock
+ * included; messages of BSP_SPI_INT_THRESHOLD words or more go through the interrupt path */
+static int spibench(int argc, char **argv)
+{
+    struct rt_spi_device *device;
+    struct rt_spi_configuration cfg;
+    struct swm181_spi_bus *bus;
+    rt_uint8_t *send, *recv;
+    rt_size_t len = argc > 2 ? atoi(argv[2]) : 256;
+    rt_uint32_t sck;
+
+    if (argc < 2 || argc > 4 || len == 0)
+    {
+        rt_kprintf("Usage: spibench <spi device> [len] [max_hz]\n");
+        return -RT_EINVAL;
+    }
+    device = (struct rt_spi_device *)rt_device_find(argv[1]);
+    if (device == RT_NULL || device->parent.type != RT_Device_Class_SPIDevice)
+    {
+        rt_kprintf("%s is not an SPI device\n", argv[1]);
+        return -RT_EINVAL;
+    }
+
+    send = rt_malloc(len);
+    recv = rt_malloc(len);
+    if (send == RT_NULL || recv == RT_NULL)
+    {
+        rt_free(send);
+        rt_free(recv);
+        return -RT_ENOMEM;
+    }
+    rt_memset(send, 0xFF, len);
+
+    cfg = device->config;
+    if (argc > 3)
+    {
+        struct rt_spi_configuration bench = cfg;
+
+        bench.max_hz = strtoul(argv[3], RT_NULL, 0);
+        rt_spi_configure(device, &bench);
+    }
+    /* settle the configuration so the divider can be read back */
+    rt_spi_transfer(device, send, RT_NULL, 1);
+    bus = (struct swm181_spi_bus *)device->bus;
+    sck = SystemCoreClock / (4 << ((bus->ctrl & SPI_CTRL_CLKDIV_Msk) >> SPI_CTRL_CLKDIV_Pos));
+
+    rt_kprintf("%s: SCK %u Hz, %d bytes per message, %d KB per run\n", argv[1], sck, (int)len,
+               SPIBENCH_TOTAL / 1024);
+    spibench_run(device, "tx", send, RT_NULL, len, sck);
+    spibench_run(device, "rx", RT_NULL, recv, len, sck);
+    spibench_run(device, "txrx", send, recv, len, sck);
+
+    if (argc > 3)
+        rt_spi_configure(device, &cfg);
+    rt_free(send);
+    rt_free(recv);
+
+    return 0;
+}
+MSH_CMD_EXPORT(spibench, SPI throughput - spibench <spi device> [len] [max_hz]);
+#endif
+
 #endif /* RT_USING_SPI */
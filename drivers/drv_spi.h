@@ -10,6 +10,22 @@
 #ifndef DRV_SPI_H__
 #define DRV_SPI_H__
 
+#include <rtthread.h>
+
+/* rt_device_control() commands of the slave devices "spis0" / "spis1" */
+#define SWM181_SPIS_CTRL_SET_MODE       (RT_DEVICE_CTRL_BASE(Char) + 0x30)     /* arg: rt_uint8_t *, RT_SPI_CPOL | RT_SPI_CPHA */
+#define SWM181_SPIS_CTRL_GET_STATS      (RT_DEVICE_CTRL_BASE(Char) + 0x31)     /* arg: struct swm181_spi_slave_stats * */
+
+struct swm181_spi_slave_stats
+{
+    rt_uint32_t frames;         /* CS low-high cycles that carried data */
+    rt_uint32_t rx_bytes;
+    rt_uint32_t overruns;       /* hardware RX FIFO overflows, words lost on the wire */
+    rt_uint32_t rx_drops;       /* RX ring full */
+    rt_uint32_t frame_merges;   /* frame table full, frame appended to the previous one */
+};
+
 int rt_hw_spi_init(void);
+rt_err_t rt_hw_spi_device_attach(const char *bus_name, const char *device_name, rt_base_t cs_pin);
 
 #endif
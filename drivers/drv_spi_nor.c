@@ -0,0 +1,506 @@
+/*
+ * Copyright (c) 2006-2022, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ */
+
+#include <rtthread.h>
+#include <rtdevice.h>
+#include <board.h>
+#include "drv_spi.h"
+#include "drv_spi_nor.h"
+
+#ifdef BSP_USING_SPI_NOR
+
+#ifndef RT_USING_MTD_NOR
+#error "SPI NOR flash needs RT_USING_MTD_NOR"
+#endif
+
+#define SPI_NOR_CMD_WREN        0x06
+#define SPI_NOR_CMD_RDSR        0x05
+#define SPI_NOR_CMD_PP          0x02
+#define SPI_NOR_CMD_FAST_READ   0x0B
+#define SPI_NOR_CMD_JEDEC_ID    0x9F
+#define SPI_NOR_CMD_SFDP        0x5A
+#define SPI_NOR_CMD_ERASE_4K    0x20
+#define SPI_NOR_CMD_ERASE_64K   0xD8
+
+#define SPI_NOR_SR_WIP          0x01
+#define SPI_NOR_PAGE_SIZE       256
+/* worst case tPP and 64 KB tBE of common parts, with margin */
+#define SPI_NOR_PP_TIMEOUT_MS   10
+#define SPI_NOR_BE_TIMEOUT_MS   4000
+/* 3-byte addressing only */
+#define SPI_NOR_MAX_SIZE        (16UL * 1024 * 1024)
+
+struct spi_nor_erase
+{
+    rt_uint32_t size;
+    rt_uint8_t cmd;
+};
+
+struct swm181_spi_nor
+{
+    struct rt_mtd_nor_device mtd;
+    struct rt_spi_device *spi;
+    struct rt_mutex lock;
+    rt_uint8_t jedec_id[3];
+    rt_uint32_t size;
+    struct spi_nor_erase erase[4];  /* largest first, size 0 ends the list */
+    rt_uint32_t cache_addr;         /* read-ahead window */
+    rt_uint32_t cache_len;          /* 0 when empty */
+    rt_uint8_t cache[BSP_SPI_NOR_CACHE_SIZE];
+};
+
+static struct swm181_spi_nor spi_nor_obj;
+
+rt_inline void spi_nor_cmd_addr(rt_uint8_t *buf, rt_uint8_t cmd, rt_uint32_t addr)
+{
+    buf[0] = cmd;
+    buf[1] = (rt_uint8_t)(addr >> 16);
+    buf[2] = (rt_uint8_t)(addr >> 8);
+    buf[3] = (rt_uint8_t)addr;
+}
+
+/* fast read and SFDP read share the layout: opcode, 3 address bytes, 1 dummy byte */
+static rt_err_t spi_nor_read_raw(struct swm181_spi_nor *nor, rt_uint8_t cmd, rt_uint32_t addr,
+                                 void *buf, rt_size_t len)
+{
+    rt_uint8_t hdr[5];
+
+    spi_nor_cmd_addr(hdr, cmd, addr);
+    hdr[4] = 0xFF;
+
+    return rt_spi_send_then_recv(nor->spi, hdr, sizeof(hdr), buf, len);
+}
+
+/* a chip that never clears WIP (gone, or write protected in a way that hangs) fails the
+ * operation with -RT_ETIMEOUT instead of holding the lock for good */
+static rt_err_t spi_nor_wait_ready(struct swm181_spi_nor *nor, rt_bool_t sleep)
+{
+    rt_uint8_t cmd = SPI_NOR_CMD_RDSR;
+    rt_tick_t timeout = rt_tick_from_millisecond(sleep ? SPI_NOR_BE_TIMEOUT_MS : SPI_NOR_PP_TIMEOUT_MS);
+    rt_tick_t start = rt_tick_get();
+    rt_uint8_t sr;
+
+    while (1)
+    {
+        if (rt_spi_send_then_recv(nor->spi, &cmd, 1, &sr, 1) != RT_EOK)
+            return -RT_EIO;
+        if ((sr & SPI_NOR_SR_WIP) == 0)
+            return RT_EOK;
+        if (rt_tick_get() - start > timeout)
+            return -RT_ETIMEOUT;
+        /* erases take milliseconds to seconds, page programs well under a tick */
+        if (sleep)
+            rt_thread_delay(1);
+    }
+}
+
+static rt_err_t spi_nor_write_enable(struct swm181_spi_nor *nor)
+{
+    rt_uint8_t cmd = SPI_NOR_CMD_WREN;
+
+    return (rt_spi_send(nor->spi, &cmd, 1) == 1) ? RT_EOK : -RT_EIO;
+}
+
+static void spi_nor_erase_add(struct swm181_spi_nor *nor, rt_uint32_t size, rt_uint8_t cmd)
+{
+    int i, j;
+
+    for (i = 0; i < 4 && nor->erase[i].size > size; i++);
+    if (i == 4 || nor->erase[i].size == size)
+        return;
+
+    for (j = 3; j > i; j--)
+        nor->erase[j] = nor->erase[j - 1];
+    nor->erase[i].size = size;
+    nor->erase[i].cmd = cmd;
+}
+
+/* JESD216 basic flash parameter table: density and up to four erase types */
+static rt_err_t spi_nor_sfdp_probe(struct swm181_spi_nor *nor)
+{
+    rt_uint8_t hdr[16];
+    rt_uint32_t bfpt[9];
+    rt_uint32_t ptr, count;
+    int i;
+
+    if (spi_nor_read_raw(nor, SPI_NOR_CMD_SFDP, 0, hdr, sizeof(hdr)) != RT_EOK)
+        return -RT_EIO;
+    if (hdr[0] != 'S' || hdr[1] != 'F' || hdr[2] != 'D' || hdr[3] != 'P')
+        return -RT_ENOSYS;
+    /* the first parameter header always points at the basic table */
+    if (hdr[8] != 0x00)
+        return -RT_ENOSYS;
+
+    count = hdr[11];
+    if (count > 9)
+        count = 9;
+    if (count < 2)
+        return -RT_ENOSYS;
+    ptr = hdr[12] | (hdr[13] << 8) | (hdr[14] << 16);
+
+    rt_memset(bfpt, 0, sizeof(bfpt));
+    if (spi_nor_read_raw(nor, SPI_NOR_CMD_SFDP, ptr, bfpt, count * 4) != RT_EOK)
+        return -RT_EIO;
+
+    /* DWORD2: density in bits, or 2^N bits when bit 31 is set */
+    if (bfpt[1] & 0x80000000UL)
+    {
+        rt_uint32_t n = bfpt[1] & 0x7FFFFFFFUL;
+
+        if (n < 3)
+            return -RT_ENOSYS;
+        nor->size = (n >= 35) ? SPI_NOR_MAX_SIZE + 1 : (rt_uint32_t)(1ULL << (n - 3));
+    }
+    else
+    {
+        nor->size = (bfpt[1] + 1) >> 3;
+    }
+
+    rt_memset(nor->erase, 0, sizeof(nor->erase));
+    if (count >= 9)
+    {
+        /* DWORD8/9: size exponent and opcode of erase types 1-4 */
+        for (i = 0; i < 4; i++)
+        {
+            rt_uint32_t dw = bfpt[7 + i / 2] >> ((i & 1) * 16);
+            rt_uint8_t exp = (rt_uint8_t)dw;
+
+            if (exp != 0 && exp < 32)
+                spi_nor_erase_add(nor, 1UL << exp, (rt_uint8_t)(dw >> 8));
+        }
+    }
+    if (nor->erase[0].size == 0 && (bfpt[0] & 0x03) == 0x01)
+    {
+        /* DWORD1: 4 KB erase supported, its opcode in bits 15:8 */
+        spi_nor_erase_add(nor, 4096, (rt_uint8_t)(bfpt[0] >> 8));
+    }
+
+    return (nor->erase[0].size != 0) ? RT_EOK : -RT_ENOSYS;
+}
+
+static rt_err_t spi_nor_probe(struct swm181_spi_nor *nor)
+{
+    rt_uint8_t cmd = SPI_NOR_CMD_JEDEC_ID;
+
+    if (rt_spi_send_then_recv(nor->spi, &cmd, 1, nor->jedec_id, 3) != RT_EOK)
+        return -RT_EIO;
+    if (nor->jedec_id[0] == 0x00 || nor->jedec_id[0] == 0xFF)
+        return -RT_EEMPTY;
+
+    if (spi_nor_sfdp_probe(nor) != RT_EOK)
+    {
+        /* no SFDP: capacity code is log2(bytes) on nearly every part, 64 KB and 4 KB erase */
+        if (nor->jedec_id[2] < 0x10 || nor->jedec_id[2] > 0x1F)
+            return -RT_ENOSYS;
+        nor->size = 1UL << nor->jedec_id[2];
+        rt_memset(nor->erase, 0, sizeof(nor->erase));
+        spi_nor_erase_add(nor, 65536, SPI_NOR_CMD_ERASE_64K);
+        spi_nor_erase_add(nor, 4096, SPI_NOR_CMD_ERASE_4K);
+    }
+
+    if (nor->size > SPI_NOR_MAX_SIZE)
+        nor->size = SPI_NOR_MAX_SIZE;
+
+    return RT_EOK;
+}
+
+static rt_uint32_t spi_nor_min_erase(struct swm181_spi_nor *nor)
+{
+    int i;
+
+    for (i = 3; i > 0 && nor->erase[i].size == 0; i--);
+    return nor->erase[i].size;
+}
+
+static rt_err_t spi_nor_read_id(struct rt_mtd_nor_device *device)
+{
+    struct swm181_spi_nor *nor = (struct swm181_spi_nor *)device;
+    rt_uint8_t cmd = SPI_NOR_CMD_JEDEC_ID;
+    rt_uint8_t id[3];
+    rt_err_t result;
+
+    rt_mutex_take(&nor->lock, RT_WAITING_FOREVER);
+    result = rt_spi_send_then_recv(nor->spi, &cmd, 1, id, 3);
+    rt_mutex_release(&nor->lock);
+
+    if (result != RT_EOK)
+        return result;
+    return rt_memcmp(id, nor->jedec_id, 3) == 0 ? RT_EOK : -RT_ERROR;
+}
+
+static rt_ssize_t spi_nor_read(struct rt_mtd_nor_device *device, rt_off_t offset, rt_uint8_t *data, rt_size_t length)
+{
+    struct swm181_spi_nor *nor = (struct swm181_spi_nor *)device;
+    rt_uint32_t addr = (rt_uint32_t)offset;
+    rt_size_t total;
+    rt_size_t n;
+
+    if (offset < 0 || addr >= nor->size)
+        return 0;
+    if (length > nor->size - addr)
+        length = nor->size - addr;
+    total = length;
+
+    rt_mutex_take(&nor->lock, RT_WAITING_FOREVER);
+    while (length)
+    {
+        if (nor->cache_len != 0 && addr >= nor->cache_addr && addr < nor->cache_addr + nor->cache_len)
+        {
+            n = nor->cache_addr + nor->cache_len - addr;
+            if (n > length)
+                n = length;
+            rt_memcpy(data, &nor->cache[addr - nor->cache_addr], n);
+        }
+        else if (length >= BSP_SPI_NOR_CACHE_SIZE)
+        {
+            /* long reads stream straight into the caller's buffer */
+            n = length;
+            if (spi_nor_read_raw(nor, SPI_NOR_CMD_FAST_READ, addr, data, n) != RT_EOK)
+                break;
+        }
+        else
+        {
+            /* short read: fetch a whole window from here on for the reads that follow */
+            nor->cache_len = 0;
+            n = nor->size - addr;
+            if (n > BSP_SPI_NOR_CACHE_SIZE)
+                n = BSP_SPI_NOR_CACHE_SIZE;
+            if (spi_nor_read_raw(nor, SPI_NOR_CMD_FAST_READ, addr, nor->cache, n) != RT_EOK)
+                break;
+            nor->cache_addr = addr;
+            nor->cache_len = n;
+            continue;
+        }
+
+        addr += n;
+        data += n;
+        length -= n;
+    }
+    rt_mutex_release(&nor->lock);
+
+    return total - length;
+}
+
+rt_inline void spi_nor_cache_drop(struct swm181_spi_nor *nor, rt_uint32_t addr, rt_uint32_t len)
+{
+    if (nor->cache_len != 0 && addr < nor->cache_addr + nor->cache_len && nor->cache_addr < addr + len)
+        nor->cache_len = 0;
+}
+
+static rt_ssize_t spi_nor_write(struct rt_mtd_nor_device *device, rt_off_t offset, const rt_uint8_t *data, rt_size_t length)
+{
+    struct swm181_spi_nor *nor = (struct swm181_spi_nor *)device;
+    rt_uint32_t addr = (rt_uint32_t)offset;
+    rt_uint8_t cmd[4];
+    rt_size_t total;
+    rt_size_t n;
+
+    if (offset < 0 || addr >= nor->size)
+        return 0;
+    if (length > nor->size - addr)
+        length = nor->size - addr;
+    total = length;
+
+    rt_mutex_take(&nor->lock, RT_WAITING_FOREVER);
+    spi_nor_cache_drop(nor, addr, length);
+    while (length)
+    {
+        /* one program command per page, as much of it as the data covers */
+        n = SPI_NOR_PAGE_SIZE - (addr & (SPI_NOR_PAGE_SIZE - 1));
+        if (n > length)
+            n = length;
+
+        spi_nor_cmd_addr(cmd, SPI_NOR_CMD_PP, addr);
+        if (spi_nor_write_enable(nor) != RT_EOK ||
+            rt_spi_send_then_send(nor->spi, cmd, sizeof(cmd), data, n) != RT_EOK ||
+            spi_nor_wait_ready(nor, RT_FALSE) != RT_EOK)
+            break;
+
+        addr += n;
+        data += n;
+        length -= n;
+    }
+    rt_mutex_release(&nor->lock);
+
+    return total - length;
+}
+
+static rt_err_t spi_nor_erase_block(struct rt_mtd_nor_device *device, rt_off_t offset, rt_size_t length)
+{
+    struct swm181_spi_nor *nor = (struct swm181_spi_nor *)device;
+    rt_uint32_t addr = (rt_uint32_t)offset;
+    rt_uint8_t cmd[4];
+    rt_err_t result = RT_EOK;
+    int i;
+
+    if (offset < 0 || addr % nor->mtd.block_size || length % nor->mtd.block_size ||
+        addr >= nor->size || length > nor->size - addr)
+        return -RT_EINVAL;
+
+    rt_mutex_take(&nor->lock, RT_WAITING_FOREVER);
+    spi_nor_cache_drop(nor, addr, length);
+    while (length)
+    {
+        /* largest erase that is aligned here and does not run past the range */
+        for (i = 0; i < 4 && nor->erase[i].size != 0; i++)
+        {
+            if ((addr & (nor->erase[i].size - 1)) == 0 && length >= nor->erase[i].size)
+                break;
+        }
+        if (i == 4 || nor->erase[i].size == 0)
+        {
+            result = -RT_EINVAL;
+            break;
+        }
+
+        spi_nor_cmd_addr(cmd, nor->erase[i].cmd, addr);
+        result = spi_nor_write_enable(nor);
+        if (result == RT_EOK && rt_spi_send(nor->spi, cmd, sizeof(cmd)) != sizeof(cmd))
+            result = -RT_EIO;
+        if (result == RT_EOK)
+            result = spi_nor_wait_ready(nor, RT_TRUE);
+        if (result != RT_EOK)
+            break;
+
+        addr += nor->erase[i].size;
+        length -= nor->erase[i].size;
+    }
+    rt_mutex_release(&nor->lock);
+
+    return result;
+}
+
+static const struct rt_mtd_nor_driver_ops spi_nor_ops =
+{
+    spi_nor_read_id,
+    spi_nor_read,
+    spi_nor_write,
+    spi_nor_erase_block,
+};
+
+int rt_hw_spi_nor_init(void)
+{
+    struct swm181_spi_nor *nor = &spi_nor_obj;
+    struct rt_spi_configuration cfg;
+    rt_base_t cs_pin = rt_pin_get(BSP_SPI_NOR_CS_PIN);
+
+    if (cs_pin < 0)
+    {
+        rt_kprintf("spi nor pin lookup failed: cs=%s\n", BSP_SPI_NOR_CS_PIN);
+        return -RT_ERROR;
+    }
+    if (rt_hw_spi_device_attach(BSP_SPI_NOR_BUS_NAME, BSP_SPI_NOR_SPI_NAME, cs_pin) != RT_EOK)
+        return -RT_ERROR;
+    nor->spi = (struct rt_spi_device *)rt_device_find(BSP_SPI_NOR_SPI_NAME);
+
+    cfg.data_width = 8;
+    cfg.mode = RT_SPI_MASTER | RT_SPI_MODE_0 | RT_SPI_MSB;
+    cfg.max_hz = BSP_SPI_NOR_MAX_HZ;
+    rt_spi_configure(nor->spi, &cfg);
+
+    if (spi_nor_probe(nor) != RT_EOK)
+    {
+        rt_kprintf("spi nor not found on %s\n", BSP_SPI_NOR_BUS_NAME);
+        return -RT_ERROR;
+    }
+
+    rt_mutex_init(&nor->lock, BSP_SPI_NOR_NAME, RT_IPC_FLAG_PRIO);
+
+    nor->mtd.block_size = spi_nor_min_erase(nor);
+    nor->mtd.block_start = 0;
+    nor->mtd.block_end = nor->size / nor->mtd.block_size;
+    nor->mtd.ops = &spi_nor_ops;
+
+    rt_kprintf("spi nor %02x%02x%02x: %d KB, erase %d B\n", nor->jedec_id[0], nor->jedec_id[1],
+               nor->jedec_id[2], nor->size / 1024, nor->mtd.block_size);
+
+    return rt_mtd_nor_register_device(BSP_SPI_NOR_NAME, &nor->mtd);
+}
+INIT_COMPONENT_EXPORT(rt_hw_spi_nor_init);
+
+
+#if defined(RT_USING_FINSH) && defined(RT_USING_HEAP)
+#include <stdlib.h>
+
+static void norbench_run(struct rt_mtd_nor_device *mtd, const char *name, rt_uint8_t *buf,
+                         rt_size_t size, rt_uint32_t count, rt_bool_t random)
+{
+    rt_uint32_t span = spi_nor_obj.size - size + 1;
+    rt_uint32_t seed = 1, addr = 0, i;
+    rt_uint64_t bytes = (rt_uint64_t)size * count;
+    rt_tick_t ticks;
+    rt_uint32_t ms;
+
+    /* start cold */
+    rt_mutex_take(&spi_nor_obj.lock, RT_WAITING_FOREVER);
+    spi_nor_obj.cache_len = 0;
+    rt_mutex_release(&spi_nor_obj.lock);
+
+    ticks = rt_tick_get();
+    for (i = 0; i < count; i++)
+    {
+        if (random)
+        {
+            seed = seed * 1103515245 + 12345;
+            addr = seed % span;
+        }
+        else if (addr >= span)
+        {
+            addr = 0;
+        }
+        rt_mtd_nor_read(mtd, addr, buf, size);
+        if (!random)
+            addr += size;
+    }
+    ticks = rt_tick_get() - ticks;
+
+    ms = ticks * 1000 / RT_TICK_PER_SECOND;
+    if (ms == 0)
+        ms = 1;
+    rt_kprintf("%-6s %6u KB/s  %5u us/read  (%u reads in %u ms)\n", name,
+               (rt_uint32_t)(bytes * 1000 / 1024 / ms), (rt_uint32_t)((rt_uint64_t)ms * 1000 / count),
+               count, ms);
+}
+
+/* read throughput through the MTD layer, read-ahead window included */
+static int norbench(int argc, char **argv)
+{
+    struct rt_mtd_nor_device *mtd;
+    rt_size_t size = argc > 1 ? atoi(argv[1]) : 16;
+    rt_uint32_t count = argc > 2 ? atoi(argv[2]) : 4096;
+    rt_uint8_t *buf;
+
+    if (argc > 3 || size == 0 || count == 0)
+    {
+        rt_kprintf("Usage: norbench [read size] [count]\n");
+        return -RT_EINVAL;
+    }
+    mtd = (struct rt_mtd_nor_device *)rt_device_find(BSP_SPI_NOR_NAME);
+    if (mtd == RT_NULL || size > spi_nor_obj.size)
+    {
+        rt_kprintf("%s not registered or smaller than %d bytes\n", BSP_SPI_NOR_NAME, (int)size);
+        return -RT_ERROR;
+    }
+
+    buf = rt_malloc(size);
+    if (buf == RT_NULL)
+        return -RT_ENOMEM;
+
+    rt_kprintf("%s: %d byte reads, read-ahead window %d bytes\n", BSP_SPI_NOR_NAME, (int)size,
+               BSP_SPI_NOR_CACHE_SIZE);
+    norbench_run(mtd, "seq", buf, size, count, RT_FALSE);
+    norbench_run(mtd, "random", buf, size, count, RT_TRUE);
+    rt_free(buf);
+
+    return 0;
+}
+MSH_CMD_EXPORT(norbench, SPI NOR read throughput - norbench [read size] [count]);
+#endif
+
+#endif /* BSP_USING_SPI_NOR */
@@ -0,0 +1,15 @@
+/*
+ * Copyright (c) 2006-2022, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ */
+
+#ifndef DRV_SPI_NOR_H__
+#define DRV_SPI_NOR_H__
+
+int rt_hw_spi_nor_init(void);
+
+#endif
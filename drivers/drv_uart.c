@@ -30,41 +30,455 @@ struct swm181_uart
     const char *name;
     const char *rx_pin_name;
     const char *tx_pin_name;
+    rt_uint8_t *tx_pool;
+    rt_uint16_t tx_bufsz;
+    rt_uint16_t rx_bufsz;
+    const char *rts_pin_name;
+    const char *cts_pin_name;
+    const char *de_pin_name;
+};
+
+#ifdef BSP_USING_UART0
+static rt_uint8_t uart0_tx_pool[BSP_UART0_TX_BUFSZ];
+#ifdef BSP_UART0_USING_FLOWCONTROL
+#define UART0_FLOWCONTROL_PINS BSP_UART0_RTS_PIN, BSP_UART0_CTS_PIN
+#else
+#define UART0_FLOWCONTROL_PINS RT_NULL, RT_NULL
+#endif
+#ifdef BSP_UART0_USING_RS485
+#define UART0_RS485_DE_PIN BSP_UART0_RS485_DE_PIN
+#else
+#define UART0_RS485_DE_PIN RT_NULL
+#endif
+#endif
+#ifdef BSP_USING_UART1
+static rt_uint8_t uart1_tx_pool[BSP_UART1_TX_BUFSZ];
+#ifdef BSP_UART1_USING_FLOWCONTROL
+#define UART1_FLOWCONTROL_PINS BSP_UART1_RTS_PIN, BSP_UART1_CTS_PIN
+#else
+#define UART1_FLOWCONTROL_PINS RT_NULL, RT_NULL
+#endif
+#ifdef BSP_UART1_USING_RS485
+#define UART1_RS485_DE_PIN BSP_UART1_RS485_DE_PIN
+#else
+#define UART1_RS485_DE_PIN RT_NULL
+#endif
+#endif
+#ifdef BSP_USING_UART2
+static rt_uint8_t uart2_tx_pool[BSP_UART2_TX_BUFSZ];
+#ifdef BSP_UART2_USING_FLOWCONTROL
+#define UART2_FLOWCONTROL_PINS BSP_UART2_RTS_PIN, BSP_UART2_CTS_PIN
+#else
+#define UART2_FLOWCONTROL_PINS RT_NULL, RT_NULL
+#endif
+#ifdef BSP_UART2_USING_RS485
+#define UART2_RS485_DE_PIN BSP_UART2_RS485_DE_PIN
+#else
+#define UART2_RS485_DE_PIN RT_NULL
+#endif
+#endif
+#ifdef BSP_USING_UART3
+static rt_uint8_t uart3_tx_pool[BSP_UART3_TX_BUFSZ];
+#ifdef BSP_UART3_USING_FLOWCONTROL
+#define UART3_FLOWCONTROL_PINS BSP_UART3_RTS_PIN, BSP_UART3_CTS_PIN
+#else
+#define UART3_FLOWCONTROL_PINS RT_NULL, RT_NULL
+#endif
+#ifdef BSP_UART3_USING_RS485
+#define UART3_RS485_DE_PIN BSP_UART3_RS485_DE_PIN
+#else
+#define UART3_RS485_DE_PIN RT_NULL
+#endif
+#endif
+
+struct swm181_uart_stats
+{
+    rt_uint32_t rx_bytes;
+    rt_uint32_t tx_bytes;
+    rt_uint32_t irqs;
+    rt_uint32_t overruns;           /* hardware RX FIFO overflows */
+    rt_uint32_t rx_drops;           /* RX ring (or frame queue) full */
+    rt_uint32_t tx_drops;           /* TX ring full in deferred console mode */
+    rt_uint32_t isr_max;            /* longest ISR run, in SysTick counts */
 };
 
 static struct swm181_uart_device
 {
     struct swm181_uart *uart_info;
     struct rt_serial_device serial;
+    struct rt_ringbuffer tx_rb;     /* filled by writers, drained by the TX threshold IRQ */
+    rt_uint16_t int_flags;          /* RT_DEVICE_FLAG_INT_RX / RT_DEVICE_FLAG_INT_TX currently enabled */
+    rt_base_t rts_pin;              /* GPIO flow control lines, active low, -1 when not wired */
+    rt_base_t cts_pin;
+    rt_bool_t flowctrl;
+    rt_bool_t cts_irq_on;           /* drv_gpio counts enables per port, only call it on a change */
+    rt_bool_t rts_held;             /* RTS deasserted because the RX ring crossed its high watermark */
+    struct rt_timer rts_timer;      /* polls the RX ring while RTS is held */
+    rt_mq_t frame_mq;               /* framed receive mode when not RT_NULL */
+    rt_uint8_t *frame_buf;
+    rt_uint16_t frame_size;
+    rt_uint16_t frame_len;
+    rt_bool_t frame_err;            /* overlong or parity error, drop at the next gap */
+    rt_uint32_t frame_gap_us;
+    rt_base_t de_pin;               /* RS-485 driver enable, active high, -1 when not wired */
+    rt_bool_t de_active;
+    rt_bool_t md_enabled;           /* 9-bit multidrop address filter */
+    rt_bool_t md_selected;          /* the last address character matched */
+    rt_uint8_t md_address;
+    rt_uint8_t md_broadcast;
+    struct swm181_uart_stats stats;
 } uart_obj[] = {
 #ifdef BSP_USING_UART0
     {
-        .uart_info = &(struct swm181_uart){UART0, IRQ0_IRQ, IRQ0_15_UART0, "uart0", BSP_UART0_RX_PIN, BSP_UART0_TX_PIN},
+        .uart_info = &(struct swm181_uart){UART0, IRQ0_IRQ, IRQ0_15_UART0, "uart0", BSP_UART0_RX_PIN, BSP_UART0_TX_PIN,
+                                           uart0_tx_pool, BSP_UART0_TX_BUFSZ, BSP_UART0_RX_BUFSZ, UART0_FLOWCONTROL_PINS,
+                                           UART0_RS485_DE_PIN},
     },
 #endif
 #ifdef BSP_USING_UART1
     {
-        .uart_info = &(struct swm181_uart){UART1, IRQ1_IRQ, IRQ0_15_UART1, "uart1", BSP_UART1_RX_PIN, BSP_UART1_TX_PIN},
+        .uart_info = &(struct swm181_uart){UART1, IRQ1_IRQ, IRQ0_15_UART1, "uart1", BSP_UART1_RX_PIN, BSP_UART1_TX_PIN,
+                                           uart1_tx_pool, BSP_UART1_TX_BUFSZ, BSP_UART1_RX_BUFSZ, UART1_FLOWCONTROL_PINS,
+                                           UART1_RS485_DE_PIN},
     },
 #endif
 #ifdef BSP_USING_UART2
     {
-        .uart_info = &(struct swm181_uart){UART2, IRQ2_IRQ, IRQ0_15_UART2, "uart2", BSP_UART2_RX_PIN, BSP_UART2_TX_PIN},
+        .uart_info = &(struct swm181_uart){UART2, IRQ2_IRQ, IRQ0_15_UART2, "uart2", BSP_UART2_RX_PIN, BSP_UART2_TX_PIN,
+                                           uart2_tx_pool, BSP_UART2_TX_BUFSZ, BSP_UART2_RX_BUFSZ, UART2_FLOWCONTROL_PINS,
+                                           UART2_RS485_DE_PIN},
     },
 #endif
 #ifdef BSP_USING_UART3
     {
-        .uart_info = &(struct swm181_uart){UART3, IRQ3_IRQ, IRQ0_15_UART3, "uart3", BSP_UART3_RX_PIN, BSP_UART3_TX_PIN},
+        .uart_info = &(struct swm181_uart){UART3, IRQ3_IRQ, IRQ0_15_UART3, "uart3", BSP_UART3_RX_PIN, BSP_UART3_TX_PIN,
+                                           uart3_tx_pool, BSP_UART3_TX_BUFSZ, BSP_UART3_RX_BUFSZ, UART3_FLOWCONTROL_PINS,
+                                           UART3_RS485_DE_PIN},
     },
 #endif
 };
 
+/* The SWM181 port mux has no RTS/CTS functions, so both lines are plain GPIOs. */
+rt_inline rt_bool_t swm181_uart_cts_held(struct swm181_uart_device *uart_dev)
+{
+    return uart_dev->flowctrl && rt_pin_read(uart_dev->cts_pin) == PIN_HIGH;
+}
+
+/* number of bytes waiting in the serial core's RX ring */
+static rt_size_t swm181_uart_rx_count(struct rt_serial_device *serial)
+{
+    struct rt_serial_rx_fifo *rx_fifo = (struct rt_serial_rx_fifo *)serial->serial_rx;
+
+    if (rx_fifo == RT_NULL)
+        return 0;
+    if (rx_fifo->is_full)
+        return serial->config.bufsz;
+    if (rx_fifo->put_index >= rx_fifo->get_index)
+        return rx_fifo->put_index - rx_fifo->get_index;
+
+    return serial->config.bufsz - rx_fifo->get_index + rx_fifo->put_index;
+}
+
+/* Hold RTS above 3/4 ring occupancy and release it again below 1/4, which leaves
+ * the peer a quarter of the ring to land bytes already in flight. */
+static void swm181_uart_rts_update(struct swm181_uart_device *uart_dev)
+{
+    struct rt_serial_device *serial = &uart_dev->serial;
+    rt_size_t count = swm181_uart_rx_count(serial);
+
+    if (!uart_dev->rts_held && count >= serial->config.bufsz * 3 / 4)
+    {
+        rt_pin_write(uart_dev->rts_pin, PIN_HIGH);
+        uart_dev->rts_held = RT_TRUE;
+        rt_timer_start(&uart_dev->rts_timer);
+    }
+    else if (uart_dev->rts_held && count <= serial->config.bufsz / 4)
+    {
+        rt_pin_write(uart_dev->rts_pin, PIN_LOW);
+        uart_dev->rts_held = RT_FALSE;
+        rt_timer_stop(&uart_dev->rts_timer);
+    }
+}
+
+static void swm181_uart_rts_timeout(void *parameter)
+{
+    struct swm181_uart_device *uart_dev = (struct swm181_uart_device *)parameter;
+    rt_base_t level;
+
+    /* the serial core has no read-side callback, so watch the ring drain from here */
+    level = rt_hw_interrupt_disable();
+    swm181_uart_rts_update(uart_dev);
+    rt_hw_interrupt_enable(level);
+}
+
+static void swm181_uart_cts_isr(void *args)
+{
+    struct swm181_uart_device *uart_dev = (struct swm181_uart_device *)args;
+    rt_base_t level;
+
+    /* peer ready again: resume the TX threshold interrupt parked by the ISR. The port IRQ
+     * runs below the UART one, which must not get in between the read and write of CTRL. */
+    level = rt_hw_interrupt_disable();
+    if (rt_ringbuffer_data_len(&uart_dev->tx_rb) != 0)
+        UART_INTTXThresholdEn(uart_dev->uart_info->UARTx);
+    rt_hw_interrupt_enable(level);
+}
+
+static void swm181_uart_flowctrl_set(struct swm181_uart_device *uart_dev, rt_bool_t enable)
+{
+    rt_base_t level;
+
+    level = rt_hw_interrupt_disable();
+    uart_dev->flowctrl = enable;
+    uart_dev->rts_held = RT_FALSE;
+    rt_timer_stop(&uart_dev->rts_timer);
+    rt_pin_write(uart_dev->rts_pin, PIN_LOW);
+    rt_hw_interrupt_enable(level);
+
+    if (uart_dev->cts_irq_on != enable)
+    {
+        rt_pin_irq_enable(uart_dev->cts_pin, enable ? PIN_IRQ_ENABLE : PIN_IRQ_DISABLE);
+        uart_dev->cts_irq_on = enable;
+    }
+}
+
+/* RS-485: enable the line driver before the first byte enters the FIFO. It is
+ * released from the TX done interrupt once the last stop bit has left the wire. */
+rt_inline void swm181_uart_de_assert(struct swm181_uart_device *uart_dev)
+{
+    if (uart_dev->de_pin < 0 || uart_dev->de_active)
+        return;
+
+    rt_pin_write(uart_dev->de_pin, PIN_HIGH);
+    uart_dev->de_active = RT_TRUE;
+    UART_INTTXDoneEn(uart_dev->uart_info->UARTx);
+    NVIC_EnableIRQ(uart_dev->uart_info->irqn);
+}
+
+/* Move as many bytes as the hardware FIFO accepts from the TX ring into the FIFO.
+ * The ring has a single consumer, so callers outside the UART ISR must mask interrupts. */
+static void swm181_uart_tx_fill(struct swm181_uart_device *uart_dev)
+{
+    UART_TypeDef *UARTx = uart_dev->uart_info->UARTx;
+    rt_uint8_t ch;
+
+    if (swm181_uart_cts_held(uart_dev))
+        return;
+
+    if (rt_ringbuffer_data_len(&uart_dev->tx_rb) != 0)
+        swm181_uart_de_assert(uart_dev);
+
+    while ((UARTx->CTRL & UART_CTRL_TXFF_Msk) == 0)
+    {
+        if (rt_ringbuffer_getchar(&uart_dev->tx_rb, &ch) == 0)
+            break;
+        UARTx->DATA = ch;
+        uart_dev->stats.tx_bytes++;
+    }
+}
+
+/* RX timeout in character times (TOTIME counts units of 10 bits) */
+static rt_uint8_t swm181_uart_frame_timeout(rt_uint32_t baud, rt_uint32_t gap_us)
+{
+    rt_uint32_t chars;
+
+    if (gap_us == 0)
+    {
+        /* Modbus RTU: t3.5, fixed at 1750us above 19200 baud */
+        if (baud <= 19200)
+            return 4;
+        gap_us = 1750;
+    }
+
+    chars = (rt_uint32_t)(((rt_uint64_t)gap_us * baud + 9999999) / 10000000);
+    if (chars == 0)
+        chars = 1;
+    if (chars > 255)
+        chars = 255;
+
+    return (rt_uint8_t)chars;
+}
+
+/* multidrop: consume address characters, pass data only while this node is addressed */
+rt_inline rt_bool_t swm181_uart_md_accept(struct swm181_uart_device *uart_dev, rt_uint32_t reg)
+{
+    rt_uint8_t addr;
+
+    if (!uart_dev->md_enabled)
+        return RT_TRUE;
+    if (!(reg & 0x100))
+        return uart_dev->md_selected;
+
+    addr = (rt_uint8_t)reg;
+    uart_dev->md_selected = addr == uart_dev->md_address ||
+                            (uart_dev->md_broadcast != 0 && (addr & uart_dev->md_broadcast) == uart_dev->md_broadcast);
+    return RT_FALSE;
+}
+
+/* Collect framed-mode bytes from the FIFO. The timeout interrupt only fires while the
+ * FIFO is non-empty, so one byte stays behind until the gap closes the frame. */
+static void swm181_uart_frame_rx(struct swm181_uart_device *uart_dev, rt_bool_t close)
+{
+    UART_TypeDef *UARTx = uart_dev->uart_info->UARTx;
+    rt_uint32_t level = (UARTx->FIFO & UART_FIFO_RXLVL_Msk) >> UART_FIFO_RXLVL_Pos;
+    rt_uint32_t reg;
+
+    if (!close)
+    {
+        if (level <= 1)
+            return;
+        level -= 1;
+    }
+
+    while (level--)
+    {
+        reg = UARTx->DATA;
+        if (!swm181_uart_md_accept(uart_dev, reg))
+            continue;
+        if ((reg & UART_DATA_PAERR_Msk) || uart_dev->frame_len >= uart_dev->frame_size)
+            uart_dev->frame_err = RT_TRUE;
+        else
+            uart_dev->frame_buf[uart_dev->frame_len++] = (rt_uint8_t)reg;
+        uart_dev->stats.rx_bytes++;
+    }
+
+    if (close)
+    {
+        if (uart_dev->frame_len != 0 && !uart_dev->frame_err &&
+            rt_mq_send(uart_dev->frame_mq, uart_dev->frame_buf, uart_dev->frame_len) != RT_EOK)
+            uart_dev->stats.rx_drops++;
+        uart_dev->frame_len = 0;
+        uart_dev->frame_err = RT_FALSE;
+    }
+}
+
+static rt_err_t swm181_uart_frame_config(struct swm181_uart_device *uart_dev, struct swm181_uart_frame_cfg *cfg)
+{
+    struct rt_serial_device *serial = &uart_dev->serial;
+    rt_uint8_t *new_buf = RT_NULL;
+    rt_uint8_t *old_buf;
+    rt_base_t level;
+
+    if (cfg != RT_NULL && cfg->mq != RT_NULL)
+    {
+        if (cfg->max_len == 0)
+            return -RT_EINVAL;
+        new_buf = rt_malloc(cfg->max_len);
+        if (new_buf == RT_NULL)
+            return -RT_ENOMEM;
+    }
+
+    level = rt_hw_interrupt_disable();
+    old_buf = uart_dev->frame_buf;
+    uart_dev->frame_buf = new_buf;
+    uart_dev->frame_mq = new_buf ? cfg->mq : RT_NULL;
+    uart_dev->frame_size = new_buf ? cfg->max_len : 0;
+    uart_dev->frame_gap_us = new_buf ? cfg->gap_us : 0;
+    uart_dev->frame_len = 0;
+    uart_dev->frame_err = RT_FALSE;
+    if (new_buf)
+        uart_dev->int_flags |= RT_DEVICE_FLAG_INT_RX;
+    else if (serial->serial_rx == RT_NULL)
+        uart_dev->int_flags &= ~RT_DEVICE_FLAG_INT_RX;
+    rt_hw_interrupt_enable(level);
+
+    rt_free(old_buf);
+
+    /* reprogram TOTIME for the new gap */
+    serial->ops->configure(serial, &serial->config);
+    if (uart_dev->int_flags & RT_DEVICE_FLAG_INT_RX)
+        NVIC_EnableIRQ(uart_dev->uart_info->irqn);
+
+    return RT_EOK;
+}
+
+static rt_err_t swm181_uart_autobaud(struct swm181_uart_device *uart_dev, struct swm181_uart_autobaud *ab)
+{
+    struct rt_serial_device *serial = &uart_dev->serial;
+    UART_TypeDef *UARTx = uart_dev->uart_info->UARTx;
+    rt_tick_t start = rt_tick_get();
+    rt_uint32_t res;
+    volatile rt_uint32_t data;
+
+    if (ab == RT_NULL)
+        return -RT_EINVAL;
+    /* the 9th bit is only meaningful with 9 data bits, UART_ABRStart() hangs on anything else */
+    if (ab->detect_char > 0x1FF || (ab->detect_char > 0xFF && serial->config.data_bits != DATA_BITS_9))
+        return -RT_EINVAL;
+    switch (ab->detect_char & 0xFF)
+    {
+    case 0xFF: case 0xFE: case 0xF8: case 0x80:
+        break;
+    default:
+        return -RT_EINVAL;
+    }
+    /* the detector does not work with parity enabled */
+    if (serial->config.parity != PARITY_NONE)
+        return -RT_EINVAL;
+
+    /* nothing received at the old rate is worth keeping */
+    UART_INTRXThresholdDis(UARTx);
+    UART_INTTimeoutDis(UARTx);
+    UART_ABRStart(UARTx, ab->detect_char & 0xFF);
+
+    while ((res = UART_ABRIsDone(UARTx)) == 0)
+    {
+        if (ab->timeout != RT_WAITING_FOREVER && rt_tick_get() - start >= (rt_tick_t)ab->timeout)
+        {
+            UARTx->BAUD &= ~UART_BAUD_ABREN_Msk;
+            break;
+        }
+        rt_thread_delay(1);
+    }
+
+    while (UARTx->CTRL & UART_CTRL_RXNE_Msk)
+        data = UARTx->DATA;
+    (void)data;
+
+    if (res == UART_ABR_RES_OK)
+    {
+        ab->baud_rate = UART_GetBaudrate(UARTx);
+        serial->config.baud_rate = ab->baud_rate;
+    }
+
+    /* same divisor again, plus RX timeout and interrupt enables for the new rate */
+    serial->ops->configure(serial, &serial->config);
+
+    if (res == 0)
+        return -RT_ETIMEOUT;
+    return (res == UART_ABR_RES_OK) ? RT_EOK : -RT_ERROR;
+}
+
+static rt_err_t swm181_uart_multidrop_config(struct swm181_uart_device *uart_dev, struct swm181_uart_multidrop_cfg *cfg)
+{
+    rt_base_t level;
+
+    if (cfg != RT_NULL && uart_dev->serial.config.data_bits != DATA_BITS_9)
+        return -RT_EINVAL;
+
+    level = rt_hw_interrupt_disable();
+    uart_dev->md_enabled = cfg != RT_NULL;
+    uart_dev->md_selected = RT_FALSE;
+    uart_dev->md_address = cfg ? cfg->address : 0;
+    uart_dev->md_broadcast = cfg ? cfg->broadcast_mask : 0;
+    rt_hw_interrupt_enable(level);
+
+    return RT_EOK;
+}
+
 static rt_err_t swm181_uart_configure(struct rt_serial_device *serial, struct serial_configure *cfg)
 {
     struct swm181_uart_device *uart_dev = (struct swm181_uart_device *)serial->parent.user_data;
     struct swm181_uart *uart = uart_dev->uart_info;
     UART_InitStructure UART_initStruct;
 
+    if (cfg->flowcontrol == RT_SERIAL_FLOWCONTROL_CTSRTS && (uart_dev->rts_pin < 0 || uart_dev->cts_pin < 0))
+        return -RT_EINVAL;
+
+    /* without a 9th bit there are no address characters to filter on */
+    if (cfg->data_bits != DATA_BITS_9)
+        uart_dev->md_enabled = RT_FALSE;
+
     UART_initStruct.Baudrate = cfg->baud_rate;
     
     switch (cfg->data_bits)
@@ -109,20 +523,25 @@ static rt_err_t swm181_uart_configure(struct rt_serial_device *serial, struct se
         break;
     }
 
+    /* a reconfigure must not drop the interrupt sources that are already in use */
     UART_initStruct.RXThreshold = 3;
-    UART_initStruct.RXThresholdIEn = 1;
+    UART_initStruct.RXThresholdIEn = (uart_dev->int_flags & RT_DEVICE_FLAG_INT_RX) ? 1 : 0;
     UART_initStruct.TXThreshold = 3;
-    UART_initStruct.TXThresholdIEn = 0;
-    UART_initStruct.TimeoutTime = 10;
-    UART_initStruct.TimeoutIEn = 1;
+    UART_initStruct.TXThresholdIEn = (rt_ringbuffer_data_len(&uart_dev->tx_rb) != 0) ? 1 : 0;
+    UART_initStruct.TimeoutTime = uart_dev->frame_mq ? swm181_uart_frame_timeout(cfg->baud_rate, uart_dev->frame_gap_us) : 10;
+    UART_initStruct.TimeoutIEn = (uart_dev->int_flags & RT_DEVICE_FLAG_INT_RX) ? 1 : 0;
 
     UART_Init(uart->UARTx, &UART_initStruct);
     
     IRQ_Connect(uart->periph_irq, uart->irqn, 1);
-    NVIC_DisableIRQ(uart->irqn);
+    if (uart_dev->int_flags == 0 && rt_ringbuffer_data_len(&uart_dev->tx_rb) == 0 && !uart_dev->de_active)
+        NVIC_DisableIRQ(uart->irqn);
     
     UART_Open(uart->UARTx);
 
+    if (uart_dev->rts_pin >= 0 && uart_dev->cts_pin >= 0)
+        swm181_uart_flowctrl_set(uart_dev, cfg->flowcontrol == RT_SERIAL_FLOWCONTROL_CTSRTS);
+
     return RT_EOK;
 }
 
@@ -130,20 +549,48 @@ static rt_err_t swm181_uart_control(struct rt_serial_device *serial, int cmd, vo
 {
     struct swm181_uart_device *uart_dev = (struct swm181_uart_device *)serial->parent.user_data;
     struct swm181_uart *uart = uart_dev->uart_info;
+    rt_ubase_t flag = (rt_ubase_t)arg;
 
     switch (cmd)
     {
     case RT_DEVICE_CTRL_CLR_INT:
-        NVIC_DisableIRQ(uart->irqn);
-        UART_INTRXThresholdDis(uart->UARTx);
-        UART_INTTimeoutDis(uart->UARTx);
+        if (flag == RT_DEVICE_FLAG_INT_TX)
+        {
+            /* bytes already queued keep draining, the ISR masks TX once the ring is empty */
+            uart_dev->int_flags &= ~RT_DEVICE_FLAG_INT_TX;
+        }
+        else
+        {
+            UART_INTRXThresholdDis(uart->UARTx);
+            UART_INTTimeoutDis(uart->UARTx);
+            uart_dev->int_flags &= ~RT_DEVICE_FLAG_INT_RX;
+        }
+        if (uart_dev->int_flags == 0 && rt_ringbuffer_data_len(&uart_dev->tx_rb) == 0 && !uart_dev->de_active)
+            NVIC_DisableIRQ(uart->irqn);
         break;
 
     case RT_DEVICE_CTRL_SET_INT:
-        UART_INTRXThresholdEn(uart->UARTx);
-        UART_INTTimeoutEn(uart->UARTx);
+        if (flag == RT_DEVICE_FLAG_INT_TX)
+        {
+            uart_dev->int_flags |= RT_DEVICE_FLAG_INT_TX;
+        }
+        else
+        {
+            UART_INTRXThresholdEn(uart->UARTx);
+            UART_INTTimeoutEn(uart->UARTx);
+            uart_dev->int_flags |= RT_DEVICE_FLAG_INT_RX;
+        }
         NVIC_EnableIRQ(uart->irqn);
         break;
+
+    case SWM181_UART_CTRL_SET_FRAME:
+        return swm181_uart_frame_config(uart_dev, (struct swm181_uart_frame_cfg *)arg);
+
+    case SWM181_UART_CTRL_AUTOBAUD:
+        return swm181_uart_autobaud(uart_dev, (struct swm181_uart_autobaud *)arg);
+
+    case SWM181_UART_CTRL_SET_MULTIDROP:
+        return swm181_uart_multidrop_config(uart_dev, (struct swm181_uart_multidrop_cfg *)arg);
     }
 
     return RT_EOK;
@@ -153,9 +600,59 @@ static int swm181_uart_putc(struct rt_serial_device *serial, char c)
 {
     struct swm181_uart_device *uart_dev = (struct swm181_uart_device *)serial->parent.user_data;
     struct swm181_uart *uart = uart_dev->uart_info;
+    rt_base_t level;
+
+    if (uart_dev->int_flags & RT_DEVICE_FLAG_INT_TX)
+    {
+        if (rt_ringbuffer_putchar(&uart_dev->tx_rb, (rt_uint8_t)c) == 0)
+        {
+            /* ring full: the serial core sleeps until the ISR reports TX_DONE */
+            if (rt_interrupt_get_nest() == 0)
+                return -1;
+
+            /* No sleeping in interrupt context, push the ring out by polling. While the
+             * peer holds CTS nothing moves, drop the byte rather than spin forever. */
+            level = rt_hw_interrupt_disable();
+            while (rt_ringbuffer_putchar(&uart_dev->tx_rb, (rt_uint8_t)c) == 0)
+            {
+                if (swm181_uart_cts_held(uart_dev))
+                {
+                    uart_dev->stats.tx_drops++;
+                    rt_hw_interrupt_enable(level);
+                    return 1;
+                }
+                swm181_uart_tx_fill(uart_dev);
+            }
+            rt_hw_interrupt_enable(level);
+        }
+
+        level = rt_hw_interrupt_disable();
+        UART_INTTXThresholdEn(uart->UARTx);
+        rt_hw_interrupt_enable(level);
+
+        return 1;
+    }
 
-    while (UART_IsTXFIFOFull(uart->UARTx));
-    UART_WriteByte(uart->UARTx, c);
+    /* polled mode: the TX ISR may be refilling the FIFO from the ring at the same time */
+    while (swm181_uart_cts_held(uart_dev));
+    while (1)
+    {
+        level = rt_hw_interrupt_disable();
+        /* bytes still queued in the ring (deferred console) go out first */
+        if (rt_ringbuffer_data_len(&uart_dev->tx_rb) != 0)
+        {
+            swm181_uart_tx_fill(uart_dev);
+        }
+        else if (!UART_IsTXFIFOFull(uart->UARTx))
+        {
+            swm181_uart_de_assert(uart_dev);
+            UART_WriteByte(uart->UARTx, c);
+            uart_dev->stats.tx_bytes++;
+            rt_hw_interrupt_enable(level);
+            break;
+        }
+        rt_hw_interrupt_enable(level);
+    }
 
     return 1;
 }
@@ -163,14 +660,20 @@ static int swm181_uart_putc(struct rt_serial_device *serial, char c)
 static int swm181_uart_getc(struct rt_serial_device *serial)
 {
     struct swm181_uart_device *uart_dev = (struct swm181_uart_device *)serial->parent.user_data;
-    struct swm181_uart *uart = uart_dev->uart_info;
-    uint32_t data;
+    UART_TypeDef *UARTx = uart_dev->uart_info->UARTx;
+    uint32_t reg;
 
-    if (UART_IsRXFIFOEmpty(uart->UARTx))
-        return -1;
-
-    if (UART_ReadByte(uart->UARTx, &data) == 0)
-        return (int)data;
+    /* Called back to back by the serial core until it returns -1, so the whole
+     * hardware FIFO is drained per interrupt; keep it to plain register reads. */
+    while (UARTx->CTRL & UART_CTRL_RXNE_Msk)
+    {
+        reg = UARTx->DATA;
+        if ((reg & UART_DATA_PAERR_Msk) == 0 && swm181_uart_md_accept(uart_dev, reg))
+        {
+            uart_dev->stats.rx_bytes++;
+            return (int)(reg & UART_DATA_DATA_Msk);
+        }
+    }
 
     return -1;
 }
@@ -188,17 +691,70 @@ static void swm181_uart_isr(struct rt_serial_device *serial)
 {
     struct swm181_uart_device *uart_dev = (struct swm181_uart_device *)serial->parent.user_data;
     struct swm181_uart *uart = uart_dev->uart_info;
+    rt_uint32_t t0 = SysTick->VAL;
+    uint32_t stat = uart->UARTx->BAUD;
+    rt_uint32_t t;
+
+    uart_dev->stats.irqs++;
+    if (uart->UARTx->CTRL & UART_CTRL_RXOV_Msk)
+    {
+        uart->UARTx->CTRL |= UART_CTRL_RXOV_Msk;
+        uart_dev->stats.overruns++;
+    }
 
-    if (UART_INTRXThresholdStat(uart->UARTx) || UART_INTTimeoutStat(uart->UARTx))
+    if (uart_dev->frame_mq != RT_NULL)
+    {
+        if (stat & (UART_BAUD_RXIF_Msk | UART_BAUD_TOIF_Msk))
+            swm181_uart_frame_rx(uart_dev, (stat & UART_BAUD_TOIF_Msk) != 0);
+    }
+    else if (stat & (UART_BAUD_RXIF_Msk | UART_BAUD_TOIF_Msk))
     {
+        rt_size_t room = serial->config.bufsz - swm181_uart_rx_count(serial);
+        rt_uint32_t rx_bytes = uart_dev->stats.rx_bytes;
+
         rt_hw_serial_isr(serial, RT_SERIAL_EVENT_RX_IND);
+        /* the serial core overwrites the oldest bytes once its ring is full */
+        rx_bytes = uart_dev->stats.rx_bytes - rx_bytes;
+        if (rx_bytes > room)
+            uart_dev->stats.rx_drops += rx_bytes - room;
+        if (uart_dev->flowctrl)
+            swm181_uart_rts_update(uart_dev);
     }
 
-    if (UART_INTTXDoneStat(uart->UARTx))
+    if (stat & UART_BAUD_TXIF_Msk)
     {
-        UART_INTTXDoneDis(uart->UARTx);
-        rt_hw_serial_isr(serial, RT_SERIAL_EVENT_TX_DONE);
+        swm181_uart_tx_fill(uart_dev);
+        /* ring empty, or parked until the CTS falling edge */
+        if (rt_ringbuffer_data_len(&uart_dev->tx_rb) == 0 || swm181_uart_cts_held(uart_dev))
+            UART_INTTXThresholdDis(uart->UARTx);
+
+        /* wake a writer blocked on a full ring once half of it is free again */
+        if (serial->serial_tx != RT_NULL &&
+            rt_ringbuffer_space_len(&uart_dev->tx_rb) >= rt_ringbuffer_get_size(&uart_dev->tx_rb) / 2)
+        {
+            rt_hw_serial_isr(serial, RT_SERIAL_EVENT_TX_DONE);
+        }
     }
+
+    if (stat & UART_BAUD_TXDOIF_Msk)
+    {
+        /* a refill above may already have restarted the transmitter */
+        if (rt_ringbuffer_data_len(&uart_dev->tx_rb) == 0 && !UART_IsTXBusy(uart->UARTx))
+        {
+            UART_INTTXDoneDis(uart->UARTx);
+            if (uart_dev->de_active)
+            {
+                rt_pin_write(uart_dev->de_pin, PIN_LOW);
+                uart_dev->de_active = RT_FALSE;
+            }
+        }
+    }
+
+    /* SysTick counts down and reloads once per tick */
+    t = SysTick->VAL;
+    t = (t <= t0) ? t0 - t : t0 + SysTick->LOAD + 1 - t;
+    if (t > uart_dev->stats.isr_max)
+        uart_dev->stats.isr_max = t;
 }
 
 #ifdef BSP_USING_UART0
@@ -258,6 +814,103 @@ void IRQ3_Handler(void)
 }
 #endif
 
+#ifdef BSP_USING_CONSOLE_ASYNC
+static struct swm181_uart_device *console_uart;
+
+/* No TX interrupt will drain the ring: interrupts masked, scheduler not started,
+ * or inside NMI / HardFault, where the assert or fault report must still go out. */
+rt_inline rt_bool_t swm181_uart_console_must_poll(void)
+{
+    rt_uint32_t ipsr = __get_IPSR();
+
+    return __get_PRIMASK() != 0 || rt_thread_self() == RT_NULL || ipsr == 2 || ipsr == 3;
+}
+
+/* push the ring out by polling, gives up while the peer holds CTS */
+static void swm181_uart_console_flush(struct swm181_uart_device *uart_dev)
+{
+    while (rt_ringbuffer_data_len(&uart_dev->tx_rb) != 0 && !swm181_uart_cts_held(uart_dev))
+        swm181_uart_tx_fill(uart_dev);
+}
+
+static void swm181_uart_console_put(struct swm181_uart_device *uart_dev, char c, rt_bool_t poll)
+{
+    if (poll && rt_ringbuffer_space_len(&uart_dev->tx_rb) == 0)
+        swm181_uart_console_flush(uart_dev);
+    if (rt_ringbuffer_putchar(&uart_dev->tx_rb, (rt_uint8_t)c) == 0)
+        uart_dev->stats.tx_drops++;
+}
+
+/* Only this path is deferred: it appends to the TX ring of the console port and never
+ * waits for the line. Writes to the console device itself keep the usual semantics. */
+void rt_hw_console_output(const char *str)
+{
+    struct swm181_uart_device *uart_dev = console_uart;
+    rt_bool_t open, poll;
+    rt_base_t level;
+
+    if (uart_dev == RT_NULL)
+        return;
+
+    /* before the first open configure() picks the pending ring up */
+    open = (uart_dev->serial.parent.open_flag & RT_DEVICE_OFLAG_OPEN) != 0;
+    poll = open && swm181_uart_console_must_poll();
+
+    level = rt_hw_interrupt_disable();
+    while (*str)
+    {
+        if (*str == '\n')
+            swm181_uart_console_put(uart_dev, '\r', poll);
+        swm181_uart_console_put(uart_dev, *str++, poll);
+    }
+    if (poll)
+    {
+        swm181_uart_console_flush(uart_dev);
+    }
+    else if (open)
+    {
+        UART_INTTXThresholdEn(uart_dev->uart_info->UARTx);
+        NVIC_EnableIRQ(uart_dev->uart_info->irqn);
+    }
+    rt_hw_interrupt_enable(level);
+}
+
+/* The kernel writes to the console device once it is set, which would bypass the
+ * deferral above. rt_kprintf() takes rt_hw_console_output() while the console is the
+ * async port and writes to the device like the kernel does after a redirection. */
+int rt_kprintf(const char *fmt, ...)
+{
+    char buf[RT_CONSOLEBUF_SIZE];
+    va_list args;
+    int length;
+#ifdef RT_USING_DEVICE
+    rt_device_t console = rt_console_get_device();
+    rt_uint16_t old_flag;
+#endif
+
+    va_start(args, fmt);
+    length = rt_vsnprintf(buf, sizeof(buf), fmt, args);
+    va_end(args);
+    if (length > RT_CONSOLEBUF_SIZE - 1)
+        length = RT_CONSOLEBUF_SIZE - 1;
+
+#ifdef RT_USING_DEVICE
+    if (console != RT_NULL && (console_uart == RT_NULL || console != &console_uart->serial.parent))
+    {
+        old_flag = console->open_flag;
+        console->open_flag |= RT_DEVICE_FLAG_STREAM;
+        rt_device_write(console, 0, buf, length);
+        console->open_flag = old_flag;
+
+        return length;
+    }
+#endif
+    rt_hw_console_output(buf);
+
+    return length;
+}
+#endif
+
 int rt_hw_uart_init(void)
 {
     struct serial_configure serial_cfg = RT_SERIAL_CONFIG_DEFAULT;
@@ -286,15 +939,98 @@ int rt_hw_uart_init(void)
         PORT_Init(SWM181_PIN_GET_PORT_PTR(rx_pin), SWM181_PIN_GET_PIN_IDX(rx_pin), rx_func, 1);
         PORT_Init(SWM181_PIN_GET_PORT_PTR(tx_pin), SWM181_PIN_GET_PIN_IDX(tx_pin), tx_func, 0);
 
+        rt_ringbuffer_init(&uart_obj[i].tx_rb, info->tx_pool, info->tx_bufsz);
+#ifdef BSP_USING_CONSOLE_ASYNC
+        if (rt_strcmp(info->name, RT_CONSOLE_DEVICE_NAME) == 0)
+            console_uart = &uart_obj[i];
+#endif
+
+        uart_obj[i].de_pin = -1;
+        if (info->de_pin_name != RT_NULL)
+        {
+            rt_base_t de_pin = rt_pin_get(info->de_pin_name);
+
+            if (de_pin < 0)
+            {
+                rt_kprintf("uart pin lookup failed: %s de=%s\n", info->name, info->de_pin_name);
+            }
+            else
+            {
+                rt_pin_mode(de_pin, PIN_MODE_OUTPUT);
+                rt_pin_write(de_pin, PIN_LOW);
+                uart_obj[i].de_pin = de_pin;
+            }
+        }
+
+        uart_obj[i].rts_pin = -1;
+        uart_obj[i].cts_pin = -1;
+        if (info->rts_pin_name != RT_NULL && info->cts_pin_name != RT_NULL)
+        {
+            rt_base_t rts_pin = rt_pin_get(info->rts_pin_name);
+            rt_base_t cts_pin = rt_pin_get(info->cts_pin_name);
+
+            if (rts_pin < 0 || cts_pin < 0)
+            {
+                rt_kprintf("uart pin lookup failed: %s rts=%s cts=%s\n", info->name, info->rts_pin_name, info->cts_pin_name);
+            }
+            else
+            {
+                rt_pin_mode(rts_pin, PIN_MODE_OUTPUT);
+                rt_pin_write(rts_pin, PIN_LOW);
+                rt_pin_mode(cts_pin, PIN_MODE_INPUT_PULLUP);
+                rt_pin_attach_irq(cts_pin, PIN_IRQ_MODE_FALLING, swm181_uart_cts_isr, &uart_obj[i]);
+                rt_timer_init(&uart_obj[i].rts_timer, info->name, swm181_uart_rts_timeout, &uart_obj[i],
+                              1, RT_TIMER_FLAG_PERIODIC | RT_TIMER_FLAG_HARD_TIMER);
+                uart_obj[i].rts_pin = rts_pin;
+                uart_obj[i].cts_pin = cts_pin;
+            }
+        }
+
         uart_obj[i].serial.ops = &swm181_uart_ops;
         uart_obj[i].serial.config = serial_cfg;
+        /* the serial core allocates the RX ring from this on open */
+        uart_obj[i].serial.config.bufsz = info->rx_bufsz;
 
         rt_hw_serial_register(&uart_obj[i].serial, info->name,
-                                RT_DEVICE_FLAG_RDWR | RT_DEVICE_FLAG_INT_RX, &uart_obj[i]);
+                                RT_DEVICE_FLAG_RDWR | RT_DEVICE_FLAG_INT_RX | RT_DEVICE_FLAG_INT_TX, &uart_obj[i]);
     }
 
     return 0;
 }
 INIT_BOARD_EXPORT(rt_hw_uart_init);
 
+#ifdef RT_USING_FINSH
+static int uartstat(int argc, char **argv)
+{
+    rt_bool_t reset = argc > 1 && rt_strcmp(argv[1], "-r") == 0;
+    int i;
+
+    if (argc > 1 && !reset)
+    {
+        rt_kprintf("Usage: uartstat [-r]\n");
+        return -RT_EINVAL;
+    }
+
+    rt_kprintf("port   rx_bytes   tx_bytes   irqs       overrun  rx_drop  tx_drop  isr_max(us)\n");
+    for (i = 0; i < sizeof(uart_obj) / sizeof(uart_obj[0]); i++)
+    {
+        struct swm181_uart_stats st;
+        rt_base_t level;
+
+        level = rt_hw_interrupt_disable();
+        st = uart_obj[i].stats;
+        if (reset)
+            rt_memset(&uart_obj[i].stats, 0, sizeof(uart_obj[i].stats));
+        rt_hw_interrupt_enable(level);
+
+        rt_kprintf("%-6s %-10u %-10u %-10u %-8u %-8u %-8u %u\n", uart_obj[i].uart_info->name,
+                   st.rx_bytes, st.tx_bytes, st.irqs, st.overruns, st.rx_drops, st.tx_drops,
+                   st.isr_max / (SystemCoreClock / 1000000));
+    }
+
+    return 0;
+}
+MSH_CMD_EXPORT(uartstat, show UART counters - uartstat [-r] to reset after printing);
+#endif
+
 #endif /* RT_USING_SERIAL */
@@ -10,6 +10,40 @@
 #ifndef DRV_UART_H__
 #define DRV_UART_H__
 
+#include <rtthread.h>
+
+/* Framed receive: an RX idle gap closes a frame, which is posted whole to cfg->mq and
+ * rt_mq_recv() returns its length. Pass RT_NULL to go back to the byte stream. */
+#define SWM181_UART_CTRL_SET_FRAME      (RT_DEVICE_CTRL_BASE(Char) + 0x10)
+
+struct swm181_uart_frame_cfg
+{
+    rt_mq_t mq;                 /* one message per frame, msg_size >= max_len */
+    rt_uint16_t max_len;        /* longer frames are dropped */
+    rt_uint32_t gap_us;         /* idle time ending a frame, 0 = Modbus RTU t3.5 at the current baud rate */
+};
+
+/* Auto-baud: arm the detector and wait for the peer to send detect_char, then run the
+ * port at the measured rate. Fails with -RT_ETIMEOUT, or -RT_ERROR if the measurement failed. */
+#define SWM181_UART_CTRL_AUTOBAUD       (RT_DEVICE_CTRL_BASE(Char) + 0x11)
+
+struct swm181_uart_autobaud
+{
+    rt_uint16_t detect_char;    /* 0xFF, 0xFE, 0xF8 or 0x80 (0x1xx with 9 data bits) */
+    rt_int32_t timeout;         /* ticks, RT_WAITING_FOREVER to wait forever */
+    rt_uint32_t baud_rate;      /* out: measured baud rate */
+};
+
+/* 9-bit multidrop receive: a character with the 9th bit set is an address, the data after it
+ * reaches the serial ring only if the address matched. Needs DATA_BITS_9. Pass RT_NULL to turn off. */
+#define SWM181_UART_CTRL_SET_MULTIDROP  (RT_DEVICE_CTRL_BASE(Char) + 0x12)
+
+struct swm181_uart_multidrop_cfg
+{
+    rt_uint8_t address;         /* this node */
+    rt_uint8_t broadcast_mask;  /* an address with all of these bits set selects every node, 0 = no broadcast */
+};
+
 int rt_hw_uart_init(void);
 
 #endif
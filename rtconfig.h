@@ -291,6 +291,8 @@
 #define BSP_USING_UART0
 #define BSP_UART0_RX_PIN "PA0"
 #define BSP_UART0_TX_PIN "PA1"
+#define BSP_UART0_RX_BUFSZ 64
+#define BSP_UART0_TX_BUFSZ 64
 
 /* I2C Drivers */
 
@@ -0,0 +1,7 @@
+/* host stand-in, drv_can.h only needs the CAN message type by name */
+#ifndef RT_DEVICE_H__
+#define RT_DEVICE_H__
+
+struct rt_can_msg;
+
+#endif
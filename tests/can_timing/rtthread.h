@@ -0,0 +1,26 @@
+/* host stand-in for the few kernel types drv_can_timing.c uses */
+#ifndef RT_THREAD_H__
+#define RT_THREAD_H__
+
+#include <stdint.h>
+
+typedef int8_t      rt_int8_t;
+typedef int16_t     rt_int16_t;
+typedef int32_t     rt_int32_t;
+typedef int64_t     rt_int64_t;
+typedef uint8_t     rt_uint8_t;
+typedef uint16_t    rt_uint16_t;
+typedef uint32_t    rt_uint32_t;
+typedef int         rt_bool_t;
+typedef long        rt_base_t;
+typedef rt_base_t   rt_err_t;
+
+#define RT_TRUE     1
+#define RT_FALSE    0
+#define RT_NULL     ((void *)0)
+
+#define RT_EOK      0
+#define RT_ERROR    1
+#define RT_EINVAL   10
+
+#endif
@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2006-2022, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ */
+
+/* Host test of swm181_can_calc_timing(), run with "make" in this directory. */
+
+#include <stdio.h>
+#include "rtthread.h"
+#include "drv_can.h"
+
+#define CLK_24M     24000000    /* SystemCoreClock / 2 at the default 48 MHz */
+#define CLK_12M     12000000
+
+/* segment lengths are hardware counts, i.e. the register fields plus one */
+static const struct
+{
+    rt_uint32_t clk;
+    rt_uint32_t bitrate;
+    rt_uint16_t sample_point;   /* requested, permille, 0 for the default */
+    rt_err_t result;
+    rt_uint8_t brp, bs1, bs2, sjw;
+    rt_uint16_t sp;             /* achieved */
+    rt_int32_t ppm;
+} cases[] =
+{
+    /* clk      bitrate  sp   result      brp bs1 bs2 sjw  sp   ppm */
+    { CLK_24M, 1000000,   0, RT_EOK,       3,  6,  1,  1, 875,      0 },
+    { CLK_24M,  800000,   0, RT_EOK,       2, 12,  2,  2, 866,      0 },
+    { CLK_24M,  500000,   0, RT_EOK,       3, 13,  2,  2, 875,      0 },
+    { CLK_24M,  250000,   0, RT_EOK,       6, 13,  2,  2, 875,      0 },
+    { CLK_24M,  125000,   0, RT_EOK,      12, 13,  2,  2, 875,      0 },
+    { CLK_24M,  100000,   0, RT_EOK,      15, 13,  2,  2, 875,      0 },
+    { CLK_24M,   50000,   0, RT_EOK,      30, 13,  2,  2, 875,      0 },
+    { CLK_24M,   20000,   0, RT_EOK,      60, 16,  3,  3, 850,      0 },
+    /* slowest reachable rate: 24 MHz / (64 * 25 tq) */
+    { CLK_24M,   15000,   0, RT_EOK,      64, 16,  8,  4, 680,      0 },
+    /* out of range, the closest candidate is still reported */
+    { CLK_24M,   10000,   0, -RT_ERROR,   64, 16,  8,  4, 680, 500000 },
+    { CLK_24M, 1000000, 875, RT_EOK,       3,  6,  1,  1, 875,      0 },
+    { CLK_24M,  500000, 750, RT_EOK,       3, 11,  4,  4, 750,      0 },
+    { CLK_12M, 1000000,   0, RT_EOK,       1,  9,  2,  2, 833,      0 },
+    { CLK_12M,  500000,   0, RT_EOK,       3,  6,  1,  1, 875,      0 },
+    { CLK_12M,  125000,   0, RT_EOK,       6, 13,  2,  2, 875,      0 },
+    { CLK_12M,   10000,   0, RT_EOK,      60, 16,  3,  3, 850,      0 },
+};
+
+int main(void)
+{
+    int i, failed = 0;
+
+    for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+    {
+        struct swm181_can_timing t = { 0 };
+        rt_err_t result = swm181_can_calc_timing(cases[i].clk, cases[i].bitrate, cases[i].sample_point, &t);
+        rt_uint32_t ntq = 1 + (t.bs1 + 1) + (t.bs2 + 1);
+
+        if (result != cases[i].result ||
+            t.brp + 1 != cases[i].brp || t.bs1 + 1 != cases[i].bs1 ||
+            t.bs2 + 1 != cases[i].bs2 || t.sjw + 1 != cases[i].sjw ||
+            t.sample_point != cases[i].sp || t.error_ppm != cases[i].ppm ||
+            /* the reported figures must match what the fields program */
+            t.bitrate != cases[i].clk / ((t.brp + 1) * ntq) ||
+            t.sample_point != (t.bs1 + 2) * 1000 / ntq)
+        {
+            printf("FAIL %u Hz %u bit/s: result %ld brp %u bs1 %u bs2 %u sjw %u sp %u ppm %ld\n",
+                   (unsigned)cases[i].clk, (unsigned)cases[i].bitrate, (long)result,
+                   t.brp + 1, t.bs1 + 1, t.bs2 + 1, t.sjw + 1, t.sample_point, (long)t.error_ppm);
+            failed++;
+        }
+    }
+
+    if (swm181_can_calc_timing(CLK_24M, 0, 0, &(struct swm181_can_timing){ 0 }) != -RT_EINVAL ||
+        swm181_can_calc_timing(CLK_24M, 500000, 0, RT_NULL) != -RT_EINVAL)
+    {
+        printf("FAIL invalid arguments accepted\n");
+        failed++;
+    }
+
+    printf("%d of %d cases passed\n", (int)(sizeof(cases) / sizeof(cases[0])) + 1 - failed,
+           (int)(sizeof(cases) / sizeof(cases[0])) + 1);
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,5 @@
+/* host stand-in, drv_spi_nor.c needs nothing from the board header */
+#ifndef __BOARD_H__
+#define __BOARD_H__
+
+#endif
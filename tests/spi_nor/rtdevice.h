@@ -0,0 +1,71 @@
+/* host stand-in for the SPI, pin and MTD NOR interfaces drv_spi_nor.c uses */
+#ifndef RT_DEVICE_H__
+#define RT_DEVICE_H__
+
+#include <rtthread.h>
+
+#define RT_SPI_CPHA             (1 << 0)
+#define RT_SPI_CPOL             (1 << 1)
+#define RT_SPI_MSB              (1 << 2)
+#define RT_SPI_MASTER           (0 << 3)
+#define RT_SPI_MODE_0           (0 | 0)
+
+struct rt_spi_configuration
+{
+    rt_uint8_t mode;
+    rt_uint8_t data_width;
+    rt_uint16_t reserved;
+    rt_uint32_t max_hz;
+};
+
+struct rt_spi_device
+{
+    struct rt_device parent;
+    struct rt_spi_configuration config;
+};
+
+rt_err_t rt_spi_configure(struct rt_spi_device *device, struct rt_spi_configuration *cfg);
+rt_err_t rt_spi_send_then_recv(struct rt_spi_device *device, const void *send_buf, rt_size_t send_length,
+                               void *recv_buf, rt_size_t recv_length);
+rt_err_t rt_spi_send_then_send(struct rt_spi_device *device, const void *send_buf1, rt_size_t send_length1,
+                               const void *send_buf2, rt_size_t send_length2);
+rt_ssize_t rt_spi_send(struct rt_spi_device *device, const void *send_buf, rt_size_t length);
+
+rt_base_t rt_pin_get(const char *name);
+
+struct rt_mtd_nor_driver_ops;
+struct rt_mtd_nor_device
+{
+    struct rt_device parent;
+    rt_uint32_t block_size;
+    rt_uint32_t block_start;
+    rt_uint32_t block_end;
+    const struct rt_mtd_nor_driver_ops *ops;
+};
+
+struct rt_mtd_nor_driver_ops
+{
+    rt_err_t (*read_id)(struct rt_mtd_nor_device *device);
+    rt_ssize_t (*read)(struct rt_mtd_nor_device *device, rt_off_t offset, rt_uint8_t *data, rt_size_t length);
+    rt_ssize_t (*write)(struct rt_mtd_nor_device *device, rt_off_t offset, const rt_uint8_t *data, rt_size_t length);
+    rt_err_t (*erase_block)(struct rt_mtd_nor_device *device, rt_off_t offset, rt_size_t length);
+};
+
+rt_err_t rt_mtd_nor_register_device(const char *name, struct rt_mtd_nor_device *device);
+
+rt_inline rt_ssize_t rt_mtd_nor_read(struct rt_mtd_nor_device *device, rt_off_t offset, rt_uint8_t *data, rt_size_t length)
+{
+    return device->ops->read(device, offset, data, length);
+}
+
+rt_inline rt_ssize_t rt_mtd_nor_write(struct rt_mtd_nor_device *device, rt_off_t offset, const rt_uint8_t *data, rt_size_t length)
+{
+    return device->ops->write(device, offset, data, length);
+}
+
+rt_inline rt_err_t rt_mtd_nor_erase_block(struct rt_mtd_nor_device *device, rt_off_t offset, rt_size_t length)
+{
+    return device->ops->erase_block(device, offset, length);
+}
+
+#endif
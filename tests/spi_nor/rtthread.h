@@ -0,0 +1,73 @@
+/* host stand-in for the kernel interfaces drv_spi_nor.c uses, implemented in test_spi_nor.c */
+#ifndef RT_THREAD_H__
+#define RT_THREAD_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef int8_t          rt_int8_t;
+typedef int16_t         rt_int16_t;
+typedef int32_t         rt_int32_t;
+typedef int64_t         rt_int64_t;
+typedef uint8_t         rt_uint8_t;
+typedef uint16_t        rt_uint16_t;
+typedef uint32_t        rt_uint32_t;
+typedef uint64_t        rt_uint64_t;
+typedef int             rt_bool_t;
+typedef long            rt_base_t;
+typedef unsigned long   rt_ubase_t;
+typedef rt_base_t       rt_err_t;
+typedef rt_uint32_t     rt_tick_t;
+typedef rt_ubase_t      rt_size_t;
+typedef rt_base_t       rt_ssize_t;
+typedef rt_base_t       rt_off_t;
+
+#define RT_TRUE                 1
+#define RT_FALSE                0
+#define RT_NULL                 ((void *)0)
+
+#define RT_EOK                  0
+#define RT_ERROR                1
+#define RT_ETIMEOUT             2
+#define RT_EFULL                3
+#define RT_EEMPTY               4
+#define RT_ENOMEM               5
+#define RT_ENOSYS               6
+#define RT_EBUSY                7
+#define RT_EIO                  8
+#define RT_EINVAL               10
+
+#define RT_WAITING_FOREVER      -1
+#define RT_TICK_PER_SECOND      1000
+#define RT_IPC_FLAG_PRIO        0x01
+
+#define rt_inline               static inline
+#define INIT_COMPONENT_EXPORT(fn)
+
+typedef struct rt_device *rt_device_t;
+struct rt_device
+{
+    const char *name;
+};
+
+struct rt_mutex
+{
+    int held;
+};
+
+int rt_kprintf(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+void *rt_memcpy(void *dst, const void *src, rt_ubase_t count);
+void *rt_memset(void *s, int c, rt_ubase_t count);
+rt_int32_t rt_memcmp(const void *cs, const void *ct, rt_size_t count);
+
+rt_err_t rt_mutex_init(struct rt_mutex *mutex, const char *name, rt_uint8_t flag);
+rt_err_t rt_mutex_take(struct rt_mutex *mutex, rt_int32_t time);
+rt_err_t rt_mutex_release(struct rt_mutex *mutex);
+
+rt_tick_t rt_tick_get(void);
+rt_tick_t rt_tick_from_millisecond(rt_int32_t ms);
+rt_err_t rt_thread_delay(rt_tick_t tick);
+
+rt_device_t rt_device_find(const char *name);
+
+#endif
@@ -0,0 +1,441 @@
+/*
+ * Copyright (c) 2006-2022, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ */
+
+/* Host test of drv_spi_nor.c against a flash chip kept in RAM, run with "make" in this
+ * directory. The Makefile builds it twice, with the default read-ahead window and with a
+ * window of 1 byte, which sends every read straight to the chip.
+ *
+ * The three SPI calls of the driver are answered by the model below: JEDEC ID, SFDP, status,
+ * fast read, write enable, page program and the three erase sizes advertised in SFDP. The
+ * driver is checked for the probe result, the erase sizes it picks, page splitting, the
+ * window staying coherent with writes and erases, and giving up on a chip stuck busy.
+ *
+ * Read throughput is then measured for sequential and random reads of several sizes. Time
+ * is simulated: every SPI message costs MODEL_MSG_NS for the bus core and CS plus its bytes
+ * at BSP_SPI_NOR_MAX_HZ, every read call MODEL_CALL_NS, and every byte copied out of the
+ * window MODEL_COPY_NS, all rough figures for the 48 MHz M0. */
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <rtthread.h>
+#include <rtdevice.h>
+#include "drv_spi.h"
+#include "drv_spi_nor.h"
+
+#define MODEL_MSG_NS        6000
+#define MODEL_CALL_NS       2000
+#define MODEL_COPY_NS       85
+
+#define FLASH_SIZE          (1024 * 1024)
+#define FLASH_PAGE          256
+#define FLASH_PP_NS         700000
+#define FLASH_SFDP_BFPT     0x30
+
+#define BENCH_BYTES         (64 * 1024)
+
+static struct
+{
+    rt_uint8_t mem[FLASH_SIZE];
+    rt_uint8_t sfdp[FLASH_SFDP_BFPT + 9 * 4];
+    rt_bool_t wel;
+    rt_bool_t stuck;                /* WIP never clears */
+    rt_uint64_t now;                /* simulated clock */
+    rt_uint64_t busy_until;
+    unsigned long msgs;
+    unsigned long errors;           /* commands a real chip would ignore or get wrong */
+    struct { rt_uint8_t cmd; rt_uint32_t addr; } erases[16];
+    int erase_count;
+} flash;
+
+static struct rt_spi_device spi_dev;
+static struct rt_mtd_nor_device *mtd;
+
+/* kernel */
+int rt_kprintf(const char *fmt, ...)
+{
+    va_list args;
+    int n;
+
+    va_start(args, fmt);
+    n = vprintf(fmt, args);
+    va_end(args);
+
+    return n;
+}
+
+void *rt_memcpy(void *dst, const void *src, rt_ubase_t count)
+{
+    flash.now += (rt_uint64_t)count * MODEL_COPY_NS;
+    return memcpy(dst, src, count);
+}
+
+void *rt_memset(void *s, int c, rt_ubase_t count)                   { return memset(s, c, count); }
+rt_int32_t rt_memcmp(const void *cs, const void *ct, rt_size_t count) { return memcmp(cs, ct, count); }
+
+rt_err_t rt_mutex_init(struct rt_mutex *mutex, const char *name, rt_uint8_t flag)
+{
+    mutex->held = 0;
+    return RT_EOK;
+}
+
+rt_err_t rt_mutex_take(struct rt_mutex *mutex, rt_int32_t time)
+{
+    if (mutex->held++)
+        flash.errors++;
+    flash.now += MODEL_CALL_NS;
+    return RT_EOK;
+}
+
+rt_err_t rt_mutex_release(struct rt_mutex *mutex)
+{
+    mutex->held--;
+    return RT_EOK;
+}
+
+rt_tick_t rt_tick_get(void)                         { return (rt_tick_t)(flash.now / 1000000); }
+rt_tick_t rt_tick_from_millisecond(rt_int32_t ms)   { return ms; }
+
+rt_err_t rt_thread_delay(rt_tick_t tick)
+{
+    flash.now += (rt_uint64_t)tick * 1000000;
+    return RT_EOK;
+}
+
+rt_device_t rt_device_find(const char *name)
+{
+    return strcmp(name, BSP_SPI_NOR_SPI_NAME) == 0 ? &spi_dev.parent : RT_NULL;
+}
+
+rt_base_t rt_pin_get(const char *name)
+{
+    return strcmp(name, BSP_SPI_NOR_CS_PIN) == 0 ? 8 : -1;
+}
+
+rt_err_t rt_hw_spi_device_attach(const char *bus_name, const char *device_name, rt_base_t cs_pin)
+{
+    spi_dev.parent.name = device_name;
+    return strcmp(bus_name, BSP_SPI_NOR_BUS_NAME) == 0 && cs_pin == 8 ? RT_EOK : -RT_ERROR;
+}
+
+rt_err_t rt_spi_configure(struct rt_spi_device *device, struct rt_spi_configuration *cfg)
+{
+    device->config = *cfg;
+    return RT_EOK;
+}
+
+rt_err_t rt_mtd_nor_register_device(const char *name, struct rt_mtd_nor_device *device)
+{
+    device->parent.name = name;
+    mtd = device;
+    return RT_EOK;
+}
+
+/* flash chip */
+static void flash_init(void)
+{
+    rt_uint32_t bfpt[9] = { 0 };
+    rt_uint32_t i, seed = 1;
+
+    for (i = 0; i < FLASH_SIZE; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        flash.mem[i] = (rt_uint8_t)(seed >> 16);
+    }
+
+    /* SFDP header, one parameter header: the 9 DWORD basic table at FLASH_SFDP_BFPT */
+    memset(flash.sfdp, 0xFF, sizeof(flash.sfdp));
+    memcpy(flash.sfdp, "SFDP\x06\x01\x00\xFF", 8);
+    memcpy(flash.sfdp + 8, "\x00\x06\x01\x09", 4);
+    flash.sfdp[12] = FLASH_SFDP_BFPT;
+    flash.sfdp[13] = 0;
+    flash.sfdp[14] = 0;
+    flash.sfdp[15] = 0xFF;
+
+    bfpt[0] = 0x2001;                                   /* 4 KB erase, opcode 0x20 */
+    bfpt[1] = FLASH_SIZE * 8 - 1;                       /* density in bits - 1 */
+    bfpt[7] = (0x52 << 24) | (15 << 16) | (0x20 << 8) | 12;
+    bfpt[8] = (0xD8 << 8) | 16;
+    memcpy(flash.sfdp + FLASH_SFDP_BFPT, bfpt, sizeof(bfpt));
+}
+
+static void flash_msg(rt_size_t bytes)
+{
+    flash.msgs++;
+    flash.now += MODEL_MSG_NS + (rt_uint64_t)bytes * 8 * 1000000000 / BSP_SPI_NOR_MAX_HZ;
+}
+
+static rt_bool_t flash_busy(void)
+{
+    return flash.stuck || flash.now < flash.busy_until;
+}
+
+static rt_uint32_t flash_addr(const rt_uint8_t *cmd)
+{
+    return (cmd[1] << 16) | (cmd[2] << 8) | cmd[3];
+}
+
+rt_err_t rt_spi_send_then_recv(struct rt_spi_device *device, const void *send_buf, rt_size_t send_length,
+                               void *recv_buf, rt_size_t recv_length)
+{
+    const rt_uint8_t *cmd = send_buf;
+    rt_uint8_t *out = recv_buf;
+    rt_uint32_t addr;
+    rt_size_t i;
+
+    flash_msg(send_length + recv_length);
+    if (cmd[0] != 0x05 && flash_busy())
+    {
+        /* a busy chip only answers status reads */
+        flash.errors++;
+        memset(recv_buf, 0xFF, recv_length);
+        return RT_EOK;
+    }
+
+    switch (cmd[0])
+    {
+    case 0x9F:
+        memcpy(out, "\xEF\x40\x14", recv_length < 3 ? recv_length : 3);
+        break;
+    case 0x05:
+        out[0] = flash_busy() ? 0x03 : (flash.wel ? 0x02 : 0x00);
+        break;
+    case 0x0B:
+    case 0x5A:
+        if (send_length != 5)
+        {
+            flash.errors++;
+            break;
+        }
+        addr = flash_addr(cmd);
+        for (i = 0; i < recv_length; i++)
+        {
+            if (cmd[0] == 0x0B)
+                out[i] = flash.mem[(addr + i) % FLASH_SIZE];
+            else
+                out[i] = (addr + i < sizeof(flash.sfdp)) ? flash.sfdp[addr + i] : 0xFF;
+        }
+        break;
+    default:
+        flash.errors++;
+        break;
+    }
+
+    return RT_EOK;
+}
+
+/* page program: the address wraps inside the page like on the real part */
+rt_err_t rt_spi_send_then_send(struct rt_spi_device *device, const void *send_buf1, rt_size_t send_length1,
+                               const void *send_buf2, rt_size_t send_length2)
+{
+    const rt_uint8_t *cmd = send_buf1;
+    const rt_uint8_t *data = send_buf2;
+    rt_uint32_t addr, page;
+    rt_size_t i;
+
+    flash_msg(send_length1 + send_length2);
+    if (flash_busy() || !flash.wel || cmd[0] != 0x02 || send_length1 != 4 || send_length2 > FLASH_PAGE)
+    {
+        flash.errors++;
+        return RT_EOK;
+    }
+
+    addr = flash_addr(cmd) % FLASH_SIZE;
+    page = addr & ~(FLASH_PAGE - 1);
+    if ((addr & (FLASH_PAGE - 1)) + send_length2 > FLASH_PAGE)
+        flash.errors++;
+    for (i = 0; i < send_length2; i++)
+        flash.mem[page + ((addr + i) & (FLASH_PAGE - 1))] &= data[i];
+    flash.wel = RT_FALSE;
+    flash.busy_until = flash.now + FLASH_PP_NS;
+
+    return RT_EOK;
+}
+
+rt_ssize_t rt_spi_send(struct rt_spi_device *device, const void *send_buf, rt_size_t length)
+{
+    const rt_uint8_t *cmd = send_buf;
+    rt_uint32_t size, addr;
+
+    flash_msg(length);
+    if (flash_busy())
+    {
+        flash.errors++;
+        return length;
+    }
+
+    switch (cmd[0])
+    {
+    case 0x06:
+        flash.wel = RT_TRUE;
+        return length;
+    case 0x20: size = 4096;  break;
+    case 0x52: size = 32768; break;
+    case 0xD8: size = 65536; break;
+    default:
+        flash.errors++;
+        return length;
+    }
+
+    addr = flash_addr(cmd) % FLASH_SIZE;
+    if (!flash.wel || length != 4 || addr % size)
+    {
+        flash.errors++;
+        return length;
+    }
+    if (flash.erase_count < 16)
+    {
+        flash.erases[flash.erase_count].cmd = cmd[0];
+        flash.erases[flash.erase_count].addr = addr;
+        flash.erase_count++;
+    }
+    memset(&flash.mem[addr], 0xFF, size);
+    flash.wel = RT_FALSE;
+    flash.busy_until = flash.now + (rt_uint64_t)size / 4096 * 40000000;
+
+    return length;
+}
+
+/* tests */
+static int failed;
+
+#define CHECK(cond, ...)                                \
+    do                                                  \
+    {                                                   \
+        if (!(cond))                                    \
+        {                                               \
+            printf("FAIL line %d: ", __LINE__);         \
+            printf(__VA_ARGS__);                        \
+            printf("\n");                               \
+            failed++;                                   \
+        }                                               \
+    } while (0)
+
+/* the read must match the chip whatever mix of window and direct reads served it */
+static void check_read(rt_uint32_t addr, rt_size_t len)
+{
+    static rt_uint8_t buf[4096];
+    rt_ssize_t n = rt_mtd_nor_read(mtd, addr, buf, len);
+
+    CHECK(n == (rt_ssize_t)len, "read %u at 0x%x returned %ld", (unsigned)len, addr, (long)n);
+    CHECK(memcmp(buf, &flash.mem[addr], len) == 0, "read %u at 0x%x returned stale data", (unsigned)len, addr);
+}
+
+static void test_functional(void)
+{
+    static const struct { rt_uint8_t cmd; rt_uint32_t addr; } erases[] =
+    {
+        { 0x20, 0x0F000 }, { 0xD8, 0x10000 }, { 0x52, 0x20000 }, { 0x20, 0x28000 },
+    };
+    rt_uint8_t data[600], buf[16];
+    rt_ssize_t n;
+    int i;
+
+    CHECK(mtd != RT_NULL, "nor0 not registered");
+    if (mtd == RT_NULL)
+        return;
+    CHECK(mtd->block_size == 4096 && mtd->block_end == FLASH_SIZE / 4096,
+          "geometry %u x %u", mtd->block_size, mtd->block_end);
+    CHECK(mtd->ops->read_id(mtd) == RT_EOK, "read_id");
+
+    /* largest aligned erase first: 4 KB up to the 64 KB boundary, 64 KB, 32 KB, 4 KB */
+    check_read(0x0F800, 16);
+    flash.erase_count = 0;
+    CHECK(rt_mtd_nor_erase_block(mtd, 0x0F000, 0x1A000) == RT_EOK, "erase");
+    CHECK(flash.erase_count == 4, "%d erase commands", flash.erase_count);
+    for (i = 0; i < 4 && i < flash.erase_count; i++)
+        CHECK(flash.erases[i].cmd == erases[i].cmd && flash.erases[i].addr == erases[i].addr,
+              "erase %d: 0x%02x at 0x%x", i, flash.erases[i].cmd, flash.erases[i].addr);
+    CHECK(rt_mtd_nor_erase_block(mtd, 0x0F800, 4096) == -RT_EINVAL, "unaligned erase accepted");
+    /* the window filled before the erase must not survive it */
+    check_read(0x0F800, 16);
+
+    /* 600 bytes from the middle of a page: three program commands, none crossing a page */
+    for (i = 0; i < sizeof(data); i++)
+        data[i] = (rt_uint8_t)(i * 13);
+    n = rt_mtd_nor_write(mtd, 0x0F8F0, data, sizeof(data));
+    CHECK(n == sizeof(data), "write returned %ld", (long)n);
+    CHECK(memcmp(&flash.mem[0x0F8F0], data, sizeof(data)) == 0, "programmed data differs");
+    check_read(0x0F800, 16);
+    check_read(0x0F8F0, sizeof(data));
+    for (i = 0; i < sizeof(data); i += 7)
+        check_read(0x0F8F0 + i, 5);
+
+    /* reads are clipped at the end of the chip */
+    n = rt_mtd_nor_read(mtd, FLASH_SIZE - 10, buf, sizeof(buf));
+    CHECK(n == 10 && memcmp(buf, &flash.mem[FLASH_SIZE - 10], 10) == 0, "read at the end returned %ld", (long)n);
+
+    /* a chip that never finishes fails the operation instead of hanging */
+    flash.stuck = RT_TRUE;
+    CHECK(rt_mtd_nor_erase_block(mtd, 0x40000, 4096) == -RT_ETIMEOUT, "stuck erase not timed out");
+    CHECK(rt_mtd_nor_write(mtd, 0x40000, data, 16) == 0, "stuck program not timed out");
+    flash.stuck = RT_FALSE;
+    flash.busy_until = 0;
+    flash.errors = 0;
+}
+
+static void bench(rt_size_t size)
+{
+    rt_uint32_t count = BENCH_BYTES / size, seed = 7, addr, i;
+    rt_uint64_t t[2];
+    unsigned long msgs[2];
+    int pass;
+
+    for (pass = 0; pass < 2; pass++)
+    {
+        /* start each pass with a window somewhere else */
+        check_read(FLASH_SIZE / 2, 1);
+
+        t[pass] = flash.now;
+        msgs[pass] = flash.msgs;
+        for (i = 0; i < count; i++)
+        {
+            if (pass == 0)
+            {
+                addr = i * size;
+            }
+            else
+            {
+                seed = seed * 1103515245 + 12345;
+                addr = (seed >> 8) % (FLASH_SIZE - size);
+            }
+            check_read(addr, size);
+        }
+        t[pass] = flash.now - t[pass];
+        msgs[pass] = flash.msgs - msgs[pass];
+    }
+
+    printf("%5u   %7.0f %7.1f   %7.0f %7.1f\n", (unsigned)size,
+           BENCH_BYTES / 1024.0 / (t[0] / 1e9), msgs[0] / (BENCH_BYTES / 1024.0),
+           BENCH_BYTES / 1024.0 / (t[1] / 1e9), msgs[1] / (BENCH_BYTES / 1024.0));
+}
+
+int main(void)
+{
+    static const rt_size_t sizes[] = { 4, 16, 64, 256, 1024, 4096 };
+    int i;
+
+    flash_init();
+    rt_hw_spi_nor_init();
+
+    test_functional();
+    if (mtd == RT_NULL)
+        return 1;
+
+    printf("read-ahead %d bytes, SCK %d Hz, %d KB per run\n", BSP_SPI_NOR_CACHE_SIZE,
+           BSP_SPI_NOR_MAX_HZ, BENCH_BYTES / 1024);
+    printf("size    seq KB/s msgs/KB   rnd KB/s msgs/KB\n");
+    for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+        bench(sizes[i]);
+
+    CHECK(flash.errors == 0, "%lu commands the chip would not have accepted", flash.errors);
+    printf("%s\n", failed ? "FAILED" : "all passed");
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,28 @@
+/* Forced into every file of the host build (-include): the device header as usual, then
+ * UART0 moved into a page of host RAM that uart_model.c watches, and the few core
+ * peripherals drv_uart.c touches replaced by host variables. */
+#ifndef HOST_REGS_H__
+#define HOST_REGS_H__
+
+#include "SWM181.h"
+
+union host_uart_page
+{
+    UART_TypeDef regs;
+    uint8_t page[4096];
+};
+
+extern union host_uart_page host_uart0;
+#undef UART0
+#define UART0                   (&host_uart0.regs)
+
+extern SysTick_Type host_systick;
+#undef SysTick
+#define SysTick                 (&host_systick)
+
+void host_nvic_enable(IRQn_Type irqn);
+void host_nvic_disable(IRQn_Type irqn);
+#define NVIC_EnableIRQ(irqn)    host_nvic_enable(irqn)
+#define NVIC_DisableIRQ(irqn)   host_nvic_disable(irqn)
+
+#endif
@@ -0,0 +1,254 @@
+/*
+ * Copyright (c) 2006-2022, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ */
+
+/* Just enough kernel and serial V1 core on pthreads to run drv_uart.c on the host. */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <rthw.h>
+#include <rtthread.h>
+#include <rtdevice.h>
+#include "uart_model.h"
+
+static pthread_mutex_t irq_lock = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
+static __thread int irq_depth;
+static __thread rt_uint8_t irq_nest;
+
+rt_base_t rt_hw_interrupt_disable(void)
+{
+    pthread_mutex_lock(&irq_lock);
+    irq_depth++;
+    return 0;
+}
+
+void rt_hw_interrupt_enable(rt_base_t level)
+{
+    irq_depth--;
+    pthread_mutex_unlock(&irq_lock);
+}
+
+int host_irq_lock_depth(void)
+{
+    return irq_depth;
+}
+
+void rt_interrupt_enter(void)           { irq_nest++; }
+void rt_interrupt_leave(void)           { irq_nest--; }
+rt_uint8_t rt_interrupt_get_nest(void)  { return irq_nest; }
+
+int rt_kprintf(const char *fmt, ...)
+{
+    va_list args;
+    int n;
+
+    va_start(args, fmt);
+    n = vprintf(fmt, args);
+    va_end(args);
+
+    return n;
+}
+
+int rt_vsnprintf(char *buf, rt_size_t size, const char *fmt, va_list args) { return vsnprintf(buf, size, fmt, args); }
+void *rt_memset(void *s, int c, rt_ubase_t n)           { return memset(s, c, n); }
+rt_int32_t rt_strcmp(const char *a, const char *b)      { return strcmp(a, b); }
+void *rt_malloc(rt_size_t size)                         { return malloc(size); }
+void rt_free(void *p)                                   { free(p); }
+
+rt_tick_t rt_tick_get(void)                 { return (rt_tick_t)(host_model_now_ns() / 1000000); }
+rt_err_t rt_thread_delay(rt_tick_t tick)    { usleep(tick * 1000); return RT_EOK; }
+rt_thread_t rt_thread_self(void)            { return (rt_thread_t)&irq_lock; }
+
+void rt_timer_init(rt_timer_t timer, const char *name, void (*timeout)(void *parameter), void *parameter,
+                   rt_tick_t time, rt_uint8_t flag)
+{
+    timer->timeout = timeout;
+    timer->parameter = parameter;
+}
+rt_err_t rt_timer_start(rt_timer_t timer)   { return RT_EOK; }
+rt_err_t rt_timer_stop(rt_timer_t timer)    { return RT_EOK; }
+
+rt_err_t rt_mq_send(rt_mq_t mq, const void *buffer, rt_size_t size) { return -RT_EFULL; }
+
+void rt_pin_mode(rt_base_t pin, rt_uint8_t mode) { }
+void rt_pin_write(rt_base_t pin, rt_ssize_t value) { }
+rt_ssize_t rt_pin_read(rt_base_t pin)       { return PIN_LOW; }
+rt_base_t rt_pin_get(const char *name)      { return 0; }
+rt_err_t rt_pin_attach_irq(rt_base_t pin, rt_uint8_t mode, void (*hdr)(void *args), void *args) { return RT_EOK; }
+rt_err_t rt_pin_irq_enable(rt_base_t pin, rt_uint8_t enabled) { return RT_EOK; }
+
+/* single producer / single consumer, the ISR runs on another host thread */
+void rt_ringbuffer_init(struct rt_ringbuffer *rb, rt_uint8_t *pool, rt_int32_t size)
+{
+    rb->buffer_ptr = pool;
+    rb->read_index = 0;
+    rb->write_index = 0;
+    rb->buffer_size = size;
+}
+
+rt_size_t rt_ringbuffer_data_len(struct rt_ringbuffer *rb)
+{
+    return __atomic_load_n(&rb->write_index, __ATOMIC_ACQUIRE) - __atomic_load_n(&rb->read_index, __ATOMIC_ACQUIRE);
+}
+
+rt_size_t rt_ringbuffer_putchar(struct rt_ringbuffer *rb, const rt_uint8_t ch)
+{
+    rt_uint32_t w = rb->write_index;
+
+    if (w - __atomic_load_n(&rb->read_index, __ATOMIC_ACQUIRE) >= rb->buffer_size)
+        return 0;
+    rb->buffer_ptr[w % rb->buffer_size] = ch;
+    __atomic_store_n(&rb->write_index, w + 1, __ATOMIC_RELEASE);
+
+    return 1;
+}
+
+rt_size_t rt_ringbuffer_getchar(struct rt_ringbuffer *rb, rt_uint8_t *ch)
+{
+    rt_uint32_t r = rb->read_index;
+
+    if (__atomic_load_n(&rb->write_index, __ATOMIC_ACQUIRE) == r)
+        return 0;
+    *ch = rb->buffer_ptr[r % rb->buffer_size];
+    __atomic_store_n(&rb->read_index, r + 1, __ATOMIC_RELEASE);
+
+    return 1;
+}
+
+static pthread_mutex_t completion_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t completion_cond = PTHREAD_COND_INITIALIZER;
+static int completion_waiting;
+
+void rt_completion_init(struct rt_completion *c)
+{
+    c->flag = 0;
+}
+
+rt_err_t rt_completion_wait(struct rt_completion *c, rt_int32_t timeout)
+{
+    pthread_mutex_lock(&completion_lock);
+    while (!c->flag)
+    {
+        /* the writer sleeps, the model clock may run ahead to the next interrupt */
+        completion_waiting = 1;
+        host_model_cpu_idle(1);
+        pthread_cond_wait(&completion_cond, &completion_lock);
+    }
+    completion_waiting = 0;
+    c->flag = 0;
+    pthread_mutex_unlock(&completion_lock);
+
+    return RT_EOK;
+}
+
+void rt_completion_done(struct rt_completion *c)
+{
+    pthread_mutex_lock(&completion_lock);
+    c->flag = 1;
+    if (completion_waiting)
+        host_model_cpu_idle(0);
+    pthread_cond_broadcast(&completion_cond);
+    pthread_mutex_unlock(&completion_lock);
+}
+
+/* serial V1 core, one port */
+static struct rt_serial_device *serial_dev;
+static const char *serial_name;
+static struct rt_serial_tx_fifo serial_tx_fifo;
+
+rt_err_t rt_hw_serial_register(struct rt_serial_device *serial, const char *name, rt_uint32_t flag, void *data)
+{
+    serial->parent.flag = flag;
+    serial->parent.user_data = data;
+    serial_dev = serial;
+    serial_name = name;
+
+    return RT_EOK;
+}
+
+void rt_hw_serial_isr(struct rt_serial_device *serial, int event)
+{
+    switch (event)
+    {
+    case RT_SERIAL_EVENT_RX_IND:
+        while (serial->ops->getc(serial) != -1);
+        break;
+
+    case RT_SERIAL_EVENT_TX_DONE:
+        if (serial->serial_tx != RT_NULL)
+            rt_completion_done(&((struct rt_serial_tx_fifo *)serial->serial_tx)->completion);
+        break;
+    }
+}
+
+struct rt_serial_device *host_serial_find(const char *name)
+{
+    return (serial_name != RT_NULL && strcmp(serial_name, name) == 0) ? serial_dev : RT_NULL;
+}
+
+rt_err_t host_serial_open(struct rt_serial_device *serial, rt_uint16_t oflag)
+{
+    if (!(serial->parent.flag & RT_DEVICE_FLAG_ACTIVATED))
+    {
+        serial->ops->configure(serial, &serial->config);
+        serial->parent.flag |= RT_DEVICE_FLAG_ACTIVATED;
+    }
+
+    if ((oflag & RT_DEVICE_FLAG_INT_TX) && (serial->parent.flag & RT_DEVICE_FLAG_INT_TX))
+    {
+        rt_completion_init(&serial_tx_fifo.completion);
+        serial->serial_tx = &serial_tx_fifo;
+        serial->ops->control(serial, RT_DEVICE_CTRL_SET_INT, (void *)RT_DEVICE_FLAG_INT_TX);
+    }
+    serial->parent.open_flag = oflag | RT_DEVICE_OFLAG_OPEN;
+
+    return RT_EOK;
+}
+
+rt_size_t host_serial_write(struct rt_serial_device *serial, const void *buffer, rt_size_t size)
+{
+    const char *data = buffer;
+    rt_size_t length = size;
+
+    if (serial->serial_tx != RT_NULL)
+    {
+        struct rt_serial_tx_fifo *tx = serial->serial_tx;
+
+        while (length)
+        {
+            if (serial->ops->putc(serial, *data) == -1)
+            {
+                rt_completion_wait(&tx->completion, RT_WAITING_FOREVER);
+                continue;
+            }
+            data++;
+            length--;
+        }
+    }
+    else
+    {
+        while (length--)
+            serial->ops->putc(serial, *data++);
+    }
+
+    return size;
+}
+
+void host_serial_close(struct rt_serial_device *serial)
+{
+    if (serial->serial_tx != RT_NULL)
+    {
+        serial->ops->control(serial, RT_DEVICE_CTRL_CLR_INT, (void *)RT_DEVICE_FLAG_INT_TX);
+        serial->serial_tx = RT_NULL;
+    }
+    serial->ops->control(serial, RT_DEVICE_CTRL_CLOSE, RT_NULL);
+    serial->parent.open_flag = RT_DEVICE_OFLAG_CLOSE;
+}
@@ -0,0 +1,127 @@
+/* host stand-in for the serial V1 core, ring buffer and pin interfaces, see host_rtt.c */
+#ifndef RT_DEVICE_H__
+#define RT_DEVICE_H__
+
+#include <rtthread.h>
+
+struct rt_ringbuffer
+{
+    rt_uint8_t *buffer_ptr;
+    rt_uint32_t read_index;     /* free running, wrapped on access */
+    rt_uint32_t write_index;
+    rt_uint32_t buffer_size;
+};
+
+void rt_ringbuffer_init(struct rt_ringbuffer *rb, rt_uint8_t *pool, rt_int32_t size);
+rt_size_t rt_ringbuffer_putchar(struct rt_ringbuffer *rb, const rt_uint8_t ch);
+rt_size_t rt_ringbuffer_getchar(struct rt_ringbuffer *rb, rt_uint8_t *ch);
+rt_size_t rt_ringbuffer_data_len(struct rt_ringbuffer *rb);
+#define rt_ringbuffer_get_size(rb)      ((rb)->buffer_size)
+#define rt_ringbuffer_space_len(rb)     ((rb)->buffer_size - rt_ringbuffer_data_len(rb))
+
+struct rt_completion
+{
+    volatile rt_uint32_t flag;
+};
+
+void rt_completion_init(struct rt_completion *c);
+rt_err_t rt_completion_wait(struct rt_completion *c, rt_int32_t timeout);
+void rt_completion_done(struct rt_completion *c);
+
+#define BAUD_RATE_115200        115200
+#define DATA_BITS_5             5
+#define DATA_BITS_6             6
+#define DATA_BITS_7             7
+#define DATA_BITS_8             8
+#define DATA_BITS_9             9
+#define STOP_BITS_1             0
+#define STOP_BITS_2             1
+#define PARITY_NONE             0
+#define PARITY_ODD              1
+#define PARITY_EVEN             2
+#define BIT_ORDER_LSB           0
+#define NRZ_NORMAL              0
+#define RT_SERIAL_RB_BUFSZ      64
+
+#define RT_SERIAL_EVENT_RX_IND      0x01
+#define RT_SERIAL_EVENT_TX_DONE     0x02
+
+#define RT_SERIAL_FLOWCONTROL_CTSRTS    1
+#define RT_SERIAL_FLOWCONTROL_NONE      0
+
+struct serial_configure
+{
+    rt_uint32_t baud_rate;
+    rt_uint32_t data_bits   :4;
+    rt_uint32_t stop_bits   :2;
+    rt_uint32_t parity      :2;
+    rt_uint32_t bit_order   :1;
+    rt_uint32_t invert      :1;
+    rt_uint32_t bufsz       :16;
+    rt_uint32_t flowcontrol :1;
+    rt_uint32_t reserved    :5;
+};
+
+#define RT_SERIAL_CONFIG_DEFAULT                    \
+{                                                   \
+    BAUD_RATE_115200, DATA_BITS_8, STOP_BITS_1,     \
+    PARITY_NONE, BIT_ORDER_LSB, NRZ_NORMAL,         \
+    RT_SERIAL_RB_BUFSZ, RT_SERIAL_FLOWCONTROL_NONE, 0 \
+}
+
+struct rt_serial_rx_fifo
+{
+    rt_uint8_t *buffer;
+    rt_uint16_t put_index, get_index;
+    rt_bool_t is_full;
+};
+
+struct rt_serial_tx_fifo
+{
+    struct rt_completion completion;
+};
+
+struct rt_serial_device
+{
+    struct rt_device parent;
+    const struct rt_uart_ops *ops;
+    struct serial_configure config;
+    void *serial_rx;
+    void *serial_tx;
+};
+
+struct rt_uart_ops
+{
+    rt_err_t (*configure)(struct rt_serial_device *serial, struct serial_configure *cfg);
+    rt_err_t (*control)(struct rt_serial_device *serial, int cmd, void *arg);
+    int (*putc)(struct rt_serial_device *serial, char c);
+    int (*getc)(struct rt_serial_device *serial);
+    rt_ssize_t (*dma_transmit)(struct rt_serial_device *serial, rt_uint8_t *buf, rt_size_t size, int direction);
+};
+
+void rt_hw_serial_isr(struct rt_serial_device *serial, int event);
+rt_err_t rt_hw_serial_register(struct rt_serial_device *serial, const char *name, rt_uint32_t flag, void *data);
+
+/* the device core of the test: open / write / close as the serial V1 core does them */
+struct rt_serial_device *host_serial_find(const char *name);
+rt_err_t host_serial_open(struct rt_serial_device *serial, rt_uint16_t oflag);
+rt_size_t host_serial_write(struct rt_serial_device *serial, const void *buffer, rt_size_t size);
+void host_serial_close(struct rt_serial_device *serial);
+
+#define PIN_LOW                 0x00
+#define PIN_HIGH                0x01
+#define PIN_MODE_OUTPUT         0x00
+#define PIN_MODE_INPUT          0x01
+#define PIN_MODE_INPUT_PULLUP   0x02
+#define PIN_IRQ_MODE_FALLING    0x01
+#define PIN_IRQ_DISABLE         0x00
+#define PIN_IRQ_ENABLE          0x01
+
+void rt_pin_mode(rt_base_t pin, rt_uint8_t mode);
+void rt_pin_write(rt_base_t pin, rt_ssize_t value);
+rt_ssize_t rt_pin_read(rt_base_t pin);
+rt_base_t rt_pin_get(const char *name);
+rt_err_t rt_pin_attach_irq(rt_base_t pin, rt_uint8_t mode, void (*hdr)(void *args), void *args);
+rt_err_t rt_pin_irq_enable(rt_base_t pin, rt_uint8_t enabled);
+
+#endif
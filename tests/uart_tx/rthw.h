@@ -0,0 +1,10 @@
+/* host stand-in: the interrupt lock is a recursive mutex shared with the simulated IRQ thread */
+#ifndef RT_HW_H__
+#define RT_HW_H__
+
+#include <rtthread.h>
+
+rt_base_t rt_hw_interrupt_disable(void);
+void rt_hw_interrupt_enable(rt_base_t level);
+
+#endif
@@ -0,0 +1,122 @@
+/* host stand-in for the kernel interfaces drv_uart.c uses, implemented in host_rtt.c */
+#ifndef RT_THREAD_H__
+#define RT_THREAD_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdarg.h>
+
+typedef int8_t          rt_int8_t;
+typedef int16_t         rt_int16_t;
+typedef int32_t         rt_int32_t;
+typedef int64_t         rt_int64_t;
+typedef uint8_t         rt_uint8_t;
+typedef uint16_t        rt_uint16_t;
+typedef uint32_t        rt_uint32_t;
+typedef uint64_t        rt_uint64_t;
+typedef int             rt_bool_t;
+typedef long            rt_base_t;
+typedef unsigned long   rt_ubase_t;
+typedef rt_base_t       rt_err_t;
+typedef rt_uint32_t     rt_tick_t;
+typedef rt_ubase_t      rt_size_t;
+typedef rt_base_t       rt_ssize_t;
+typedef rt_base_t       rt_off_t;
+
+#define RT_TRUE                 1
+#define RT_FALSE                0
+#define RT_NULL                 ((void *)0)
+
+#define RT_EOK                  0
+#define RT_ERROR                1
+#define RT_ETIMEOUT             2
+#define RT_EFULL                3
+#define RT_EEMPTY               4
+#define RT_ENOMEM               5
+#define RT_ENOSYS               6
+#define RT_EBUSY                7
+#define RT_EIO                  8
+#define RT_EINVAL               10
+
+#define RT_WAITING_FOREVER      -1
+#define RT_TICK_PER_SECOND      1000
+#define RT_NAME_MAX             8
+
+#define rt_inline               static inline
+#define rt_weak                 __attribute__((weak))
+#define INIT_BOARD_EXPORT(fn)
+
+#define RT_TIMER_FLAG_ONE_SHOT      0x0
+#define RT_TIMER_FLAG_PERIODIC      0x2
+#define RT_TIMER_FLAG_HARD_TIMER    0x0
+#define RT_TIMER_FLAG_SOFT_TIMER    0x4
+#define RT_IPC_FLAG_FIFO            0x0
+
+enum rt_device_class_type
+{
+    RT_Device_Class_Char = 0,
+};
+
+#define RT_DEVICE_FLAG_RDWR             0x003
+#define RT_DEVICE_FLAG_ACTIVATED        0x010
+#define RT_DEVICE_FLAG_STREAM           0x040
+#define RT_DEVICE_FLAG_INT_RX           0x100
+#define RT_DEVICE_FLAG_DMA_RX           0x200
+#define RT_DEVICE_FLAG_INT_TX           0x400
+#define RT_DEVICE_FLAG_DMA_TX           0x800
+
+#define RT_DEVICE_OFLAG_CLOSE           0x000
+#define RT_DEVICE_OFLAG_RDWR            0x003
+#define RT_DEVICE_OFLAG_OPEN            0x008
+
+#define RT_DEVICE_CTRL_CONFIG           0x03
+#define RT_DEVICE_CTRL_CLOSE            0x04
+#define RT_DEVICE_CTRL_SET_INT          0x06
+#define RT_DEVICE_CTRL_CLR_INT          0x07
+#define RT_DEVICE_CTRL_BASE(Type)       ((RT_Device_Class_##Type + 1) * 0x100)
+
+typedef struct rt_device *rt_device_t;
+struct rt_device
+{
+    enum rt_device_class_type type;
+    rt_uint16_t flag;
+    rt_uint16_t open_flag;
+    void *user_data;
+};
+
+struct rt_timer
+{
+    void (*timeout)(void *parameter);
+    void *parameter;
+};
+typedef struct rt_timer *rt_timer_t;
+
+struct rt_messagequeue;
+typedef struct rt_messagequeue *rt_mq_t;
+
+struct rt_thread;
+typedef struct rt_thread *rt_thread_t;
+
+int rt_kprintf(const char *fmt, ...);
+int rt_vsnprintf(char *buf, rt_size_t size, const char *fmt, va_list args);
+void *rt_memset(void *s, int c, rt_ubase_t n);
+rt_int32_t rt_strcmp(const char *a, const char *b);
+void *rt_malloc(rt_size_t size);
+void rt_free(void *p);
+
+void rt_interrupt_enter(void);
+void rt_interrupt_leave(void);
+rt_uint8_t rt_interrupt_get_nest(void);
+
+rt_tick_t rt_tick_get(void);
+rt_err_t rt_thread_delay(rt_tick_t tick);
+rt_thread_t rt_thread_self(void);
+
+void rt_timer_init(rt_timer_t timer, const char *name, void (*timeout)(void *parameter), void *parameter,
+                   rt_tick_t time, rt_uint8_t flag);
+rt_err_t rt_timer_start(rt_timer_t timer);
+rt_err_t rt_timer_stop(rt_timer_t timer);
+
+rt_err_t rt_mq_send(rt_mq_t mq, const void *buffer, rt_size_t size);
+
+#endif
@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2006-2022, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ */
+
+/* Host test of the uart0 transmit paths of drv_uart.c against the register model in
+ * uart_model.c, run with "make" in this directory.
+ *
+ * The same block is written once with the port opened without RT_DEVICE_FLAG_INT_TX, which is
+ * the busy-waiting putc every write used before the TX ring, and once with it. Both must put
+ * the block on the line unchanged. The CPU time taken by the writer plus the ISR is reported
+ * per KB next to the line time, both on the simulated clock of uart_model.c. */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <rtthread.h>
+#include <rtdevice.h>
+#include "uart_model.h"
+
+#define TEST_LEN        1024
+
+int rt_hw_uart_init(void);
+
+static rt_uint8_t tx_data[TEST_LEN];
+static rt_uint8_t line[TEST_LEN + 64];
+
+static int run(struct rt_serial_device *serial, const char *name, rt_uint16_t oflag)
+{
+    struct host_model_sample s0, s1;
+    struct timespec ts = { 0, 1000000 };
+    double kb = TEST_LEN / 1024.0;
+    int i;
+
+    for (i = 0; i < TEST_LEN; i++)
+        tx_data[i] = (rt_uint8_t)(i * 7 + i / 256);
+
+    host_model_capture_reset();
+    host_serial_open(serial, oflag);
+    host_model_stream(1);
+
+    host_model_sample(&s0);
+    host_serial_write(serial, tx_data, TEST_LEN);
+
+    /* the ring drains in the background, wait for the line to go quiet */
+    host_model_cpu_idle(1);
+    for (i = 0; i < 5000; i++)
+    {
+        host_model_sample(&s1);
+        if (s1.tx_chars >= TEST_LEN && host_model_tx_idle())
+            break;
+        nanosleep(&ts, NULL);
+    }
+    host_model_sample(&s1);
+    host_model_stream(0);
+    host_model_cpu_idle(0);
+    host_serial_close(serial);
+
+    printf("%-8s CPU %7.3f ms/KB   line %6.2f ms/KB   %4.0f ISRs/KB   %6.0f register accesses/KB\n",
+           name, (s1.cpu_ns - s0.cpu_ns) / 1e6 / kb, (s1.now_ns - s0.now_ns) / 1e6 / kb,
+           (s1.isrs - s0.isrs) / kb, (s1.accesses - s0.accesses) / kb);
+
+    if (s1.tx_chars != TEST_LEN || memcmp(line, tx_data, TEST_LEN) != 0)
+    {
+        printf("FAIL %s: %lu of %d characters on the line, or not in order\n", name,
+               (unsigned long)s1.tx_chars, TEST_LEN);
+        return 1;
+    }
+    if (s1.overflows != s0.overflows)
+    {
+        printf("FAIL %s: DATA written %lu times while the TX FIFO was full\n", name,
+               s1.overflows - s0.overflows);
+        return 1;
+    }
+
+    return 0;
+}
+
+int main(void)
+{
+    struct rt_serial_device *serial;
+    int failed = 0;
+
+    host_model_init(line, sizeof(line));
+    rt_hw_uart_init();
+    serial = host_serial_find("uart0");
+    if (serial == RT_NULL)
+    {
+        printf("FAIL uart0 not registered\n");
+        return 1;
+    }
+
+    printf("115200 8N1, %d bytes per run\n", TEST_LEN);
+    failed += run(serial, "polled", RT_DEVICE_OFLAG_RDWR);
+    failed += run(serial, "INT_TX", RT_DEVICE_OFLAG_RDWR | RT_DEVICE_FLAG_INT_TX);
+
+    host_model_exit();
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,359 @@
+/*
+ * Copyright (c) 2006-2022, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ */
+
+/* RAM-backed UART0 for the host build of drv_uart.c.
+ *
+ * The registers live in a page that is normally inaccessible. Every access by the driver
+ * faults. The handler brings the status bits up to date, opens the page and single-steps
+ * the instruction. The trap after that step picks up a write to DATA and closes the page
+ * again. The transmitter drains the 8-deep TX FIFO at the line rate programmed in BAUD.
+ * A second thread plays the NVIC and runs IRQ0_Handler() under the interrupt lock whenever
+ * the TX threshold or TX done interrupt is pending.
+ *
+ * Time is simulated, since a trapped access costs the host far more than a bus access
+ * costs the MCU. Each register access advances the clock by MODEL_ACCESS_NS, roughly an
+ * access plus the code around it at 48 MHz, and each interrupt entry by MODEL_ISR_NS. While
+ * the CPU has nothing to run, i.e. the writer sleeps and no interrupt is pending, the clock
+ * jumps ahead to the next character leaving the shifter. The CPU time reported is the
+ * clock advanced by the writer and the ISR, the line time is the whole clock.
+ *
+ * Linux on x86-64 only: the single-step uses the trap flag in the signal context. */
+
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <ucontext.h>
+#include <unistd.h>
+#include <rthw.h>
+#include <rtthread.h>
+#include "uart_model.h"
+
+#if !defined(__x86_64__) || !defined(__linux__)
+#error "the register model single-steps with the x86-64 trap flag"
+#endif
+
+#define TX_FIFO_DEPTH   8
+#define DATA_UNTOUCHED  0xFFFFFFFFu     /* no 9-bit character reads back like this */
+#define EFLAGS_TF       0x100
+#define MODEL_ACCESS_NS 400
+#define MODEL_ISR_NS    500
+
+union host_uart_page host_uart0 __attribute__((aligned(4096)));
+SysTick_Type host_systick;
+uint32_t SystemCoreClock = 48000000;
+
+void IRQ0_Handler(void);
+
+static struct
+{
+    volatile int irq_on;            /* NVIC enable of IRQ0 */
+    volatile int streaming;         /* writes under way, the IRQ thread may run the ISR */
+    volatile int stop;
+    volatile uint32_t ctrl;         /* register copies for the IRQ thread, which never faults */
+    volatile uint32_t fifo;
+    volatile int cpu_idle;          /* the writer sleeps or is done */
+    volatile uint64_t now;          /* simulated clock */
+    volatile uint64_t busy_until;   /* when the last queued character leaves the shifter */
+    volatile uint64_t cpu_ns;       /* clock advanced by the writer and the ISR */
+    uint64_t char_ns;
+    uint8_t *capture;
+    size_t capture_size;
+    volatile size_t capture_len;
+    volatile unsigned long overflows;
+    volatile unsigned long isrs;
+    volatile unsigned long accesses;
+    pthread_t irq_thread;
+} model;
+
+static void model_run(uint64_t ns)
+{
+    __atomic_add_fetch(&model.now, ns, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&model.cpu_ns, ns, __ATOMIC_RELAXED);
+}
+
+/* characters waiting in the TX FIFO, the one in the shifter not counted */
+static uint32_t model_tx_level(uint64_t now)
+{
+    uint64_t busy_until = model.busy_until;
+
+    if (now >= busy_until)
+        return 0;
+
+    return (uint32_t)((busy_until - now + model.char_ns - 1) / model.char_ns) - 1;
+}
+
+static int model_irq_pending(void)
+{
+    uint64_t now = model.now;
+    uint32_t thr = (model.fifo & UART_FIFO_TXTHR_Msk) >> UART_FIFO_TXTHR_Pos;
+
+    if ((model.ctrl & UART_CTRL_TXIE_Msk) && model_tx_level(now) <= thr)
+        return 1;
+    if ((model.ctrl & UART_CTRL_TXDOIE_Msk) && now >= model.busy_until)
+        return 1;
+
+    return 0;
+}
+
+static void model_refresh(UART_TypeDef *r)
+{
+    uint64_t now = model.now;
+    uint32_t level = model_tx_level(now);
+    uint32_t thr = (r->FIFO & UART_FIFO_TXTHR_Msk) >> UART_FIFO_TXTHR_Pos;
+    int idle = now >= model.busy_until;
+    uint32_t ctrl = r->CTRL & ~(UART_CTRL_TXIDLE_Msk | UART_CTRL_TXFF_Msk | UART_CTRL_RXNE_Msk | UART_CTRL_RXOV_Msk);
+    uint32_t baud = r->BAUD & ~(UART_BAUD_TXTHRF_Msk | UART_BAUD_TXIF_Msk | UART_BAUD_TXDOIF_Msk |
+                                UART_BAUD_RXIF_Msk | UART_BAUD_RXTHRF_Msk | UART_BAUD_TOIF_Msk | UART_BAUD_RXTOIF_Msk);
+
+    if (idle)
+        ctrl |= UART_CTRL_TXIDLE_Msk;
+    if (level >= TX_FIFO_DEPTH)
+        ctrl |= UART_CTRL_TXFF_Msk;
+    if (level <= thr)
+    {
+        baud |= UART_BAUD_TXTHRF_Msk;
+        if (ctrl & UART_CTRL_TXIE_Msk)
+            baud |= UART_BAUD_TXIF_Msk;
+    }
+    if (idle && (ctrl & UART_CTRL_TXDOIE_Msk))
+        baud |= UART_BAUD_TXDOIF_Msk;
+
+    r->CTRL = ctrl;
+    r->BAUD = baud;
+    r->FIFO = (r->FIFO & ~UART_FIFO_TXLVL_Msk) | (level << UART_FIFO_TXLVL_Pos);
+    r->DATA = DATA_UNTOUCHED;
+}
+
+static void model_tx_push(UART_TypeDef *r, uint32_t ch)
+{
+    uint64_t now = model.now;
+    uint64_t start;
+
+    if (!(r->CTRL & UART_CTRL_EN_Msk) || model_tx_level(now) >= TX_FIFO_DEPTH)
+    {
+        model.overflows++;
+        return;
+    }
+
+    /* 8N1: start bit, 8 data bits, stop bit at SystemCoreClock / 16 / (BAUD + 1) */
+    model.char_ns = 10ull * 16 * (((r->BAUD & UART_BAUD_BAUD_Msk) >> UART_BAUD_BAUD_Pos) + 1) *
+                    1000000000ull / SystemCoreClock;
+    start = (now > model.busy_until) ? now : model.busy_until;
+    model.busy_until = start + model.char_ns;
+
+    if (model.capture_len < model.capture_size)
+        model.capture[model.capture_len] = (uint8_t)ch;
+    model.capture_len++;
+}
+
+static void model_on_fault(int sig, siginfo_t *si, void *ctx)
+{
+    ucontext_t *uc = ctx;
+
+    if ((uintptr_t)si->si_addr - (uintptr_t)&host_uart0 >= sizeof(host_uart0))
+    {
+        /* a real crash, let it happen again without us */
+        signal(SIGSEGV, SIG_DFL);
+        return;
+    }
+    /* the page is opened for one instruction, two threads must not be in there at once */
+    if (model.streaming && host_irq_lock_depth() == 0)
+    {
+        static const char msg[] = "uart model: register access outside the interrupt lock\n";
+        write(2, msg, sizeof(msg) - 1);
+        abort();
+    }
+
+    mprotect(&host_uart0, sizeof(host_uart0), PROT_READ | PROT_WRITE);
+    model_refresh(&host_uart0.regs);
+    uc->uc_mcontext.gregs[REG_EFL] |= EFLAGS_TF;
+    model.accesses++;
+    model_run(MODEL_ACCESS_NS);
+}
+
+static void model_on_step(int sig, siginfo_t *si, void *ctx)
+{
+    ucontext_t *uc = ctx;
+    UART_TypeDef *r = &host_uart0.regs;
+
+    uc->uc_mcontext.gregs[REG_EFL] &= ~EFLAGS_TF;
+
+    if (r->DATA != DATA_UNTOUCHED)
+        model_tx_push(r, r->DATA & 0x1FF);
+    model.ctrl = r->CTRL;
+    model.fifo = r->FIFO;
+
+    mprotect(&host_uart0, sizeof(host_uart0), PROT_NONE);
+}
+
+static void *model_irq_entry(void *arg)
+{
+    rt_base_t level;
+    uint64_t now;
+
+    while (!model.stop)
+    {
+        if (!model.streaming)
+        {
+            sched_yield();
+            continue;
+        }
+
+        level = rt_hw_interrupt_disable();
+        if (model.irq_on && model_irq_pending())
+        {
+            model.isrs++;
+            model_run(MODEL_ISR_NS);
+            IRQ0_Handler();
+        }
+        else if (model.cpu_idle)
+        {
+            /* nothing to run, skip to the next character leaving the shifter */
+            now = model.now;
+            if (now < model.busy_until)
+                model.now = now + (model.busy_until - now - 1) % model.char_ns + 1;
+        }
+        rt_hw_interrupt_enable(level);
+        sched_yield();
+    }
+
+    return NULL;
+}
+
+void host_model_init(uint8_t *capture, size_t size)
+{
+    struct sigaction sa;
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_flags = SA_SIGINFO;
+    sa.sa_sigaction = model_on_fault;
+    sigaction(SIGSEGV, &sa, NULL);
+    sa.sa_sigaction = model_on_step;
+    sigaction(SIGTRAP, &sa, NULL);
+
+    model.capture = capture;
+    model.capture_size = size;
+    model.char_ns = 1;
+    mprotect(&host_uart0, sizeof(host_uart0), PROT_NONE);
+    pthread_create(&model.irq_thread, NULL, model_irq_entry, NULL);
+}
+
+void host_model_exit(void)
+{
+    model.stop = 1;
+    pthread_join(model.irq_thread, NULL);
+}
+
+void host_model_stream(int on)
+{
+    model.streaming = on;
+}
+
+void host_model_sample(struct host_model_sample *s)
+{
+    s->now_ns = model.now;
+    s->cpu_ns = model.cpu_ns;
+    s->tx_chars = model.capture_len;
+    s->overflows = model.overflows;
+    s->isrs = model.isrs;
+    s->accesses = model.accesses;
+}
+
+uint64_t host_model_now_ns(void)
+{
+    return model.now;
+}
+
+void host_model_cpu_idle(int idle)
+{
+    model.cpu_idle = idle;
+}
+
+void host_model_capture_reset(void)
+{
+    model.capture_len = 0;
+}
+
+int host_model_tx_idle(void)
+{
+    return model.now >= model.busy_until;
+}
+
+void host_nvic_enable(IRQn_Type irqn)
+{
+    if (irqn == IRQ0_IRQ)
+        model.irq_on = 1;
+}
+
+void host_nvic_disable(IRQn_Type irqn)
+{
+    if (irqn == IRQ0_IRQ)
+        model.irq_on = 0;
+}
+
+/* The parts of SWM181_uart.c the driver uses, same register accesses minus the clock gate
+ * in SYS, which is not modelled. The library cannot be built as is: it switches on the
+ * peripheral address cast to 32 bits. */
+
+void UART_Init(UART_TypeDef *UARTx, UART_InitStructure *initStruct)
+{
+    UART_Close(UARTx);
+
+    UARTx->CTRL |= (0x01 << UART_CTRL_BAUDEN_Pos);
+    UARTx->BAUD &= ~UART_BAUD_BAUD_Msk;
+    UARTx->BAUD |= ((SystemCoreClock / 16 / initStruct->Baudrate - 1) << UART_BAUD_BAUD_Pos);
+
+    UARTx->CTRL &= ~(UART_CTRL_DATA9b_Msk | UART_CTRL_PARITY_Msk | UART_CTRL_STOP2b_Msk);
+    UARTx->CTRL |= (initStruct->DataBits << UART_CTRL_DATA9b_Pos) |
+                   (initStruct->Parity << UART_CTRL_PARITY_Pos) |
+                   (initStruct->StopBits << UART_CTRL_STOP2b_Pos);
+
+    UARTx->FIFO &= ~(UART_FIFO_RXTHR_Msk | UART_FIFO_TXTHR_Msk);
+    UARTx->FIFO |= (initStruct->RXThreshold << UART_FIFO_RXTHR_Pos) |
+                   (initStruct->TXThreshold << UART_FIFO_TXTHR_Pos);
+
+    UARTx->CTRL &= ~UART_CTRL_TOTIME_Msk;
+    UARTx->CTRL |= (initStruct->TimeoutTime << UART_CTRL_TOTIME_Pos);
+
+    UARTx->CTRL &= ~(UART_CTRL_RXIE_Msk | UART_CTRL_TXIE_Msk | UART_CTRL_TOIE_Msk);
+    UARTx->CTRL |= (initStruct->RXThresholdIEn << UART_CTRL_RXIE_Pos) |
+                   (initStruct->TXThresholdIEn << UART_CTRL_TXIE_Pos) |
+                   (initStruct->TimeoutIEn << UART_CTRL_TOIE_Pos);
+}
+
+void UART_Open(UART_TypeDef *UARTx)             { UARTx->CTRL |= (0x01 << UART_CTRL_EN_Pos); }
+void UART_Close(UART_TypeDef *UARTx)            { UARTx->CTRL &= ~UART_CTRL_EN_Msk; }
+void UART_WriteByte(UART_TypeDef *UARTx, uint8_t data) { UARTx->DATA = data; }
+uint32_t UART_IsTXBusy(UART_TypeDef *UARTx)     { return (UARTx->CTRL & UART_CTRL_TXIDLE_Msk) ? 0 : 1; }
+uint32_t UART_IsTXFIFOFull(UART_TypeDef *UARTx) { return (UARTx->CTRL & UART_CTRL_TXFF_Msk) ? 1 : 0; }
+uint32_t UART_GetBaudrate(UART_TypeDef *UARTx)
+{
+    return SystemCoreClock / 16 / (((UARTx->BAUD & UART_BAUD_BAUD_Msk) >> UART_BAUD_BAUD_Pos) + 1);
+}
+void UART_INTRXThresholdEn(UART_TypeDef *UARTx) { UARTx->CTRL |= (0x01 << UART_CTRL_RXIE_Pos); }
+void UART_INTRXThresholdDis(UART_TypeDef *UARTx) { UARTx->CTRL &= ~(0x01 << UART_CTRL_RXIE_Pos); }
+void UART_INTTXThresholdEn(UART_TypeDef *UARTx) { UARTx->CTRL |= (0x01 << UART_CTRL_TXIE_Pos); }
+void UART_INTTXThresholdDis(UART_TypeDef *UARTx) { UARTx->CTRL &= ~(0x01 << UART_CTRL_TXIE_Pos); }
+void UART_INTTimeoutEn(UART_TypeDef *UARTx)     { UARTx->CTRL |= (0x01 << UART_CTRL_TOIE_Pos); }
+void UART_INTTimeoutDis(UART_TypeDef *UARTx)    { UARTx->CTRL &= ~(0x01 << UART_CTRL_TOIE_Pos); }
+void UART_INTTXDoneEn(UART_TypeDef *UARTx)      { UARTx->CTRL |= (0x01 << UART_CTRL_TXDOIE_Pos); }
+void UART_INTTXDoneDis(UART_TypeDef *UARTx)     { UARTx->CTRL &= ~(0x01 << UART_CTRL_TXDOIE_Pos); }
+
+/* autobaud is not modelled, the detector never finishes */
+void UART_ABRStart(UART_TypeDef *UARTx, uint32_t detectChar) { UARTx->BAUD |= UART_BAUD_ABREN_Msk; }
+uint32_t UART_ABRIsDone(UART_TypeDef *UARTx)    { return 0; }
+
+void PORT_Init(PORT_TypeDef *PORTx, uint32_t n, uint32_t func, uint32_t digit_in_en) { }
+void IRQ_Connect(uint32_t periph_interrupt, uint32_t IRQn, uint32_t priority) { }
+PORT_TypeDef *swm181_pin_get_port_ptr(uint32_t pin) { return RT_NULL; }
+uint32_t swm181_pin_get_pin_idx(uint32_t pin)   { return pin & 0x0F; }
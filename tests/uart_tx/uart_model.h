@@ -0,0 +1,30 @@
+/* host side of the UART0 register model, see uart_model.c */
+#ifndef UART_MODEL_H__
+#define UART_MODEL_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct host_model_sample
+{
+    uint64_t now_ns;                /* simulated clock */
+    uint64_t cpu_ns;                /* part of it spent by the writer and the ISR */
+    size_t tx_chars;                /* characters that went out on the line */
+    unsigned long overflows;        /* DATA written while the TX FIFO was full */
+    unsigned long isrs;
+    unsigned long accesses;         /* register accesses from the writer and the ISR */
+};
+
+void host_model_init(uint8_t *capture, size_t size);
+void host_model_exit(void);
+void host_model_stream(int on);
+void host_model_sample(struct host_model_sample *s);
+void host_model_capture_reset(void);
+int host_model_tx_idle(void);
+void host_model_cpu_idle(int idle);
+uint64_t host_model_now_ns(void);
+
+/* interrupt lock nesting of the calling thread, host_rtt.c */
+int host_irq_lock_depth(void);
+
+#endif